@@ -0,0 +1,95 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "arena.h"
+
+/**
+ * Adds a new chunk of at least \param size usable bytes to the front of arena \param a.
+ * @param a the arena.
+ * @param size minimum number of bytes the chunk must be able to hold.
+ * @return the new chunk.
+ */
+static ArenaChunk *newChunk(Arena *a, size_t size) {
+    size_t chunkSize = a->head == NULL ? ARENA_CHUNK_SIZE : 2 * a->head->size;
+    while (chunkSize < size + ARENA_ALIGNMENT) {
+        chunkSize = 2 * chunkSize;
+    }
+
+    ArenaChunk *c = malloc(sizeof(*c) + chunkSize);
+    assert(c != NULL);
+    c->size = chunkSize;
+    c->used = 0;
+    c->next = a->head;
+    a->head = c;
+    return c;
+}
+
+/**
+ * Allocates \param size bytes from arena \param a. The memory stays valid until the
+ * arena is reset or freed; it cannot be released individually.
+ * @param a the arena.
+ * @param size number of bytes to allocate.
+ * @return a pointer to the allocated memory, aligned to ARENA_ALIGNMENT.
+ */
+void *arenaAlloc(Arena *a, size_t size) {
+    ArenaChunk *c = a->head;
+    if (c != NULL) {
+        uintptr_t p = (uintptr_t)(c->data + c->used);
+        size_t pad = (ARENA_ALIGNMENT - (p % ARENA_ALIGNMENT)) % ARENA_ALIGNMENT;
+        if (c->used + pad + size <= c->size) {
+            c->used += pad + size;
+            return (void *)(p + pad);
+        }
+    }
+
+    c = newChunk(a, size);
+    uintptr_t p = (uintptr_t)c->data;
+    size_t pad = (ARENA_ALIGNMENT - (p % ARENA_ALIGNMENT)) % ARENA_ALIGNMENT;
+    c->used = pad + size;
+    return (void *)(p + pad);
+}
+
+/**
+ * Copies the first \param n characters of \param s into arena \param a.
+ * @param a the arena.
+ * @param s the string to copy.
+ * @param n number of characters to copy.
+ * @return the NUL-terminated copy.
+ */
+char *arenaStrndup(Arena *a, const char *s, size_t n) {
+    char *copy = arenaAlloc(a, n + 1);
+    memcpy(copy, s, n);
+    copy[n] = '\0';
+    return copy;
+}
+
+/**
+ * Releases everything allocated from arena \param a, but keeps its largest chunk
+ * so that the next line can be processed without calling malloc again.
+ * @param a the arena.
+ */
+void arenaReset(Arena *a) {
+    if (a->head == NULL) {
+        return;
+    }
+    ArenaChunk *c = a->head->next;
+    while (c != NULL) {
+        ArenaChunk *next = c->next;
+        free(c);
+        c = next;
+    }
+    a->head->next = NULL;
+    a->head->used = 0;
+}
+
+/**
+ * Releases all memory held by arena \param a.
+ * @param a the arena.
+ */
+void arenaFree(Arena *a) {
+    arenaReset(a);
+    free(a->head);
+    a->head = NULL;
+}
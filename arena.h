@@ -0,0 +1,29 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+#define ARENA_CHUNK_SIZE 4096
+#define ARENA_ALIGNMENT 16
+
+typedef struct ArenaChunk {
+    struct ArenaChunk *next;
+    size_t size;
+    size_t used;
+    char data[];
+} ArenaChunk;
+
+// bump allocator: everything allocated from an arena is released at once
+typedef struct Arena {
+    ArenaChunk *head;
+} Arena;
+
+void *arenaAlloc(Arena *a, size_t size);
+
+char *arenaStrndup(Arena *a, const char *s, size_t n);
+
+void arenaReset(Arena *a);
+
+void arenaFree(Arena *a);
+
+#endif
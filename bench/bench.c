@@ -0,0 +1,628 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+
+#include "arena.h"
+#include "scanner.h"
+#include "shell.h"
+#include "exec.h"
+#include "zygote.h"
+#include "wildcard.h"
+
+// Benchmarks for the scanner, the parser and the launcher of the shell. Every benchmark
+// collects a number of samples and reports the median, the 99th percentile and the mean.
+// The results are printed as a table and, with -o, appended to a file as JSON lines.
+
+#define DEFAULT_SAMPLES 200
+#define SHELL_BINARY "./shell"
+#define STRESS_STACK_LIMIT (256 * 1024)
+#define LARGE_HEAP_SIZE (256 << 20)
+
+// the program that the launch benchmarks start; "true" itself is a builtin of the shell
+#define TRUE_PROGRAM "/bin/true"
+
+// the pattern of the glob benchmark: the entries of every subdirectory
+#define GLOB_PATTERN "*/*"
+
+char *launchModeNames[] = {"fork", "spawn", "zygote"};
+
+int numSamples = DEFAULT_SAMPLES;
+FILE *jsonOut = NULL;
+char *runId = "";
+
+/**
+ * Returns the time of a monotonic clock in nanoseconds.
+ * @return the time.
+ */
+double nowNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+/**
+ * Comparison function for qsort on doubles.
+ */
+int compareDoubles(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return x < y ? -1 : x > y;
+}
+
+/**
+ * Returns percentile \param p of the sorted samples \param samples, by nearest rank.
+ * @param samples the sorted samples.
+ * @param n number of samples.
+ * @param p the percentile, between 0 and 100.
+ * @return the sample at that rank.
+ */
+double percentile(double *samples, int n, int p) {
+    int rank = (p * n + 99) / 100;
+    return samples[rank > 0 ? rank - 1 : 0];
+}
+
+/**
+ * Reports the samples of a benchmark. The samples are sorted in place.
+ * @param bench the name of the benchmark.
+ * @param param the parameters of this run, as "key=value".
+ * @param samples the measurements, in \param unit.
+ * @param n number of samples.
+ * @param unit the unit of the measurements.
+ */
+void report(char *bench, char *param, double *samples, int n, char *unit) {
+    qsort(samples, n, sizeof(*samples), compareDoubles);
+
+    double sum = 0;
+    for (int i = 0; i < n; i++) {
+        sum += samples[i];
+    }
+    double p50 = percentile(samples, n, 50);
+    double p99 = percentile(samples, n, 99);
+    double mean = sum / n;
+
+    printf("%-22s %-26s %12.1f %12.1f %12.1f  %s\n", bench, param, p50, p99, mean, unit);
+    if (jsonOut != NULL) {
+        fprintf(jsonOut, "{\"run\":\"%s\",\"bench\":\"%s\",\"param\":\"%s\",\"unit\":\"%s\","
+                "\"samples\":%d,\"p50\":%.1f,\"p99\":%.1f,\"mean\":%.1f}\n",
+                runId, bench, param, unit, n, p50, p99, mean);
+    }
+    fflush(stdout);
+}
+
+/**
+ * Builds a line of \param numTokens tokens: a command with its options, and every tenth
+ * token a chain operator.
+ * @param numTokens number of tokens.
+ * @param quoted whether the options are quoted strings.
+ * @return the line as a newly allocated string.
+ */
+char *makeLine(int numTokens, bool quoted) {
+    char *line = malloc(numTokens * 16 + 1);
+    assert(line != NULL);
+    char *p = line;
+
+    for (int i = 0; i < numTokens; i++) {
+        if (i % 10 == 0) {
+            p += sprintf(p, i == 0 ? "cmd" : " && cmd");
+            i++;
+        } else {
+            p += sprintf(p, quoted ? " \"arg %d\"" : " arg%d", i);
+        }
+    }
+    *p = '\0';
+    return line;
+}
+
+/**
+ * Writes \param numLines lines of \param lineLen characters to file descriptor \param fd.
+ * @param fd the file descriptor.
+ * @param numLines number of lines.
+ * @param lineLen length of each line, without the newline.
+ */
+void writeLines(int fd, int numLines, int lineLen) {
+    char *line = malloc(lineLen + 1);
+    assert(line != NULL);
+    for (int i = 0; i < lineLen; i++) {
+        line[i] = i % 8 == 7 ? ' ' : 'a' + i % 26;
+    }
+    line[lineLen] = '\n';
+    for (int i = 0; i < numLines; i++) {
+        if (write(fd, line, lineLen + 1) != lineLen + 1) {
+            break;
+        }
+    }
+    free(line);
+}
+
+/**
+ * Measures reading lines with readLine from a regular file, which is mapped.
+ * @param numLines number of lines in the file.
+ * @param lineLen length of each line.
+ */
+void benchReaderFile(int numLines, int lineLen) {
+    char path[] = "/tmp/shellbench.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    writeLines(fd, numLines, lineLen);
+    unlink(path);
+
+    double *samples = malloc(numSamples * sizeof(*samples));
+    for (int s = 0; s < numSamples; s++) {
+        InputReader r;
+        lseek(fd, 0, SEEK_SET);
+        double start = nowNs();
+        initInputReader(&r, fd);
+        while (readLine(&r) != NULL) {
+        }
+        closeInputReader(&r);
+        samples[s] = (nowNs() - start) / numLines;
+    }
+    close(fd);
+
+    char param[64];
+    sprintf(param, "file lines=%d len=%d", numLines, lineLen);
+    report("readInputLine", param, samples, numSamples, "ns/line");
+    free(samples);
+}
+
+/**
+ * Measures reading lines with readLine from a pipe, which is read in blocks.
+ * @param numLines number of lines written to the pipe.
+ * @param lineLen length of each line.
+ */
+void benchReaderPipe(int numLines, int lineLen) {
+    int samplesHere = numSamples / 10 > 0 ? numSamples / 10 : 1;
+    double *samples = malloc(samplesHere * sizeof(*samples));
+
+    for (int s = 0; s < samplesHere; s++) {
+        int fds[2];
+        assert(pipe(fds) == 0);
+        pid_t pid = fork();
+        if (pid == 0) {
+            close(fds[0]);
+            writeLines(fds[1], numLines, lineLen);
+            _exit(0);
+        }
+        close(fds[1]);
+
+        InputReader r;
+        double start = nowNs();
+        initInputReader(&r, fds[0]);
+        while (readLine(&r) != NULL) {
+        }
+        closeInputReader(&r);
+        samples[s] = (nowNs() - start) / numLines;
+        close(fds[0]);
+        waitpid(pid, NULL, 0);
+    }
+
+    char param[64];
+    sprintf(param, "pipe lines=%d len=%d", numLines, lineLen);
+    report("readInputLine", param, samples, samplesHere, "ns/line");
+    free(samples);
+}
+
+/**
+ * Measures getTokenList and releasing the tokens on a line of
+ * \param numTokens tokens.
+ * @param numTokens number of tokens in the line.
+ * @param quoted whether the options are quoted strings.
+ */
+void benchTokenizer(int numTokens, bool quoted) {
+    char *line = makeLine(numTokens, quoted);
+    size_t len = strlen(line);
+    char *copy = malloc(len + 1);
+    double *scan = malloc(numSamples * sizeof(*scan));
+    double *release = malloc(numSamples * sizeof(*release));
+    Arena arena = {NULL};
+
+    for (int s = 0; s < numSamples; s++) {
+        memcpy(copy, line, len + 1);    // the scanner rewrites its input
+        double start = nowNs();
+        List tokens = getTokenList(copy, &arena);
+        double mid = nowNs();
+        arenaReset(&arena);     // what freeTokenList used to do
+        double end = nowNs();
+        assert(tokens != NULL);
+        scan[s] = (mid - start) / numTokens;
+        release[s] = end - mid;
+    }
+
+    char param[64];
+    sprintf(param, "tokens=%d%s", numTokens, quoted ? " quoted" : "");
+    report("getTokenList", param, scan, numSamples, "ns/token");
+    report("freeTokenList", param, release, numSamples, "ns");
+    arenaFree(&arena);
+    free(line);
+    free(copy);
+    free(scan);
+    free(release);
+}
+
+/**
+ * Measures parseInputLine on a line of \param numTokens tokens. Parsing only builds the
+ * parse tree, so nothing is executed.
+ * @param numTokens number of tokens in the line.
+ */
+void benchParser(int numTokens) {
+    char *line = makeLine(numTokens, false);
+    size_t len = strlen(line);
+    char *copy = malloc(len + 1);
+    double *samples = malloc(numSamples * sizeof(*samples));
+    Arena arena = {NULL};
+
+    for (int s = 0; s < numSamples; s++) {
+        memcpy(copy, line, len + 1);
+        List tokens = getTokenList(copy, &arena);
+        InputLine parsed;
+        double start = nowNs();
+        bool ok = parseInputLine(&tokens, &parsed, &arena);
+        samples[s] = (nowNs() - start) / numTokens;
+        assert(ok && tokens == NULL);
+        arenaReset(&arena);
+    }
+
+    char param[64];
+    sprintf(param, "tokens=%d", numTokens);
+    report("parseInputLine", param, samples, numSamples, "ns/token");
+    arenaFree(&arena);
+    free(line);
+    free(copy);
+    free(samples);
+}
+
+/**
+ * Builds a line of \param numChains times "true", separated by operator \param op.
+ * @param numChains number of commands.
+ * @param op the operator between the commands.
+ * @return the line as a newly allocated string.
+ */
+char *makeChainLine(int numChains, char *op) {
+    char *line = malloc(numChains * (strlen(op) + 6) + 1);
+    assert(line != NULL);
+    char *p = line;
+    for (int i = 0; i < numChains; i++) {
+        p += i == 0 ? sprintf(p, "true") : sprintf(p, " %s true", op);
+    }
+    return line;
+}
+
+/**
+ * Computes the number of bytes that have been allocated from arena \param arena.
+ * @param arena the arena.
+ * @return the number of bytes.
+ */
+size_t arenaBytes(Arena *arena) {
+    size_t bytes = 0;
+    for (ArenaChunk *chunk = arena->head; chunk != NULL; chunk = chunk->next) {
+        bytes += chunk->used;
+    }
+    return bytes;
+}
+
+/**
+ * Scans and parses the line \param line, which is \param len characters long, in a child
+ * process whose stack is limited to STRESS_STACK_LIMIT bytes.
+ * @param line the line.
+ * @param len the length of the line.
+ * @return a bool denoting whether the line was parsed within the stack limit.
+ */
+bool parsesInBoundedStack(char *line, size_t len) {
+    pid_t pid = fork();
+    if (pid == 0) {
+        struct rlimit limit = {STRESS_STACK_LIMIT, STRESS_STACK_LIMIT};
+        Arena arena = {NULL};
+        InputLine parsed;
+        setrlimit(RLIMIT_STACK, &limit);
+        List tokens = getTokenList(line, &arena);
+        _exit(parseInputLine(&tokens, &parsed, &arena) && tokens == NULL ? 0 : 1);
+    }
+    int status;
+    waitpid(pid, &status, 0);
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+/**
+ * Stress test of the scanner and parser on one line of \param numChains commands,
+ * separated by operator \param op. It first checks that the line can be parsed with a
+ * small stack, and then reports the time and the arena memory per command, which should
+ * not grow with the length of the line.
+ * @param numChains number of commands in the line.
+ * @param op the operator between the commands.
+ */
+void benchParserStress(int numChains, char *op) {
+    char *line = makeChainLine(numChains, op);
+    size_t len = strlen(line);
+    char *copy = malloc(len + 1);
+    assert(copy != NULL);
+    int samplesHere = numSamples * 1000 / numChains;
+    samplesHere = samplesHere < 3 ? 3 : samplesHere > numSamples ? numSamples : samplesHere;
+    double *samples = malloc(samplesHere * sizeof(*samples));
+    double bytes = 0;
+    Arena arena = {NULL};
+    char param[64];
+    sprintf(param, "op=%s commands=%d", op, numChains);
+
+    memcpy(copy, line, len + 1);
+    if (!parsesInBoundedStack(copy, len)) {
+        printf("%-22s %-26s stack limit of %d bytes exceeded\n", "parser stress", param,
+               STRESS_STACK_LIMIT);
+        samplesHere = 0;
+    }
+
+    for (int s = 0; s < samplesHere; s++) {
+        memcpy(copy, line, len + 1);
+        InputLine parsed;
+        double start = nowNs();
+        List tokens = getTokenList(copy, &arena);
+        bool ok = parseInputLine(&tokens, &parsed, &arena);
+        samples[s] = (nowNs() - start) / numChains;
+        assert(ok && tokens == NULL);
+        bytes = arenaBytes(&arena);
+        arenaReset(&arena);
+    }
+
+    if (samplesHere > 0) {
+        report("parser stress", param, samples, samplesHere, "ns/command");
+        bytes /= numChains;
+        report("parser stress memory", param, &bytes, 1, "B/command");
+    }
+    arenaFree(&arena);
+    free(line);
+    free(copy);
+    free(samples);
+}
+
+/**
+ * Measures executing \param text in the shell itself with launch mode \param mode: the
+ * time from starting the first process until the last one has been reaped.
+ * @param name the name of the benchmark.
+ * @param text the inputline to execute.
+ * @param mode the launch mode.
+ */
+void benchLaunch(char *name, char *text, LaunchMode mode) {
+    int samplesHere = numSamples / 2 > 0 ? numSamples / 2 : 1;
+    double *samples = malloc(samplesHere * sizeof(*samples));
+    char *copy = strdup(text);
+    Arena arena = {NULL};
+    List tokens = getTokenList(copy, &arena);
+    InputLine parsed;
+    assert(parseInputLine(&tokens, &parsed, &arena) && tokens == NULL);
+
+    launchMode = mode;
+    for (int s = 0; s < samplesHere; s++) {
+        double start = nowNs();
+        runInputLine(&parsed);
+        samples[s] = (nowNs() - start) / 1000;
+    }
+
+    char param[64];
+    sprintf(param, "%s", launchModeNames[mode]);
+    report(name, param, samples, samplesHere, "us");
+    arenaFree(&arena);
+    free(copy);
+    free(samples);
+}
+
+/**
+ * Counts the paths that matchWildcards reports.
+ */
+void countMatch(char *path, void *arg) {
+    (void)path;
+    (*(int *)arg)++;
+}
+
+/**
+ * Measures matching GLOB_PATTERN in a directory with \param numDirs subdirectories of
+ * \param numFiles files each. Every match has to be found: the cache of listings grows
+ * while the subdirectories are matched, which must not disturb the listing of the parent.
+ * @param numDirs number of subdirectories.
+ * @param numFiles number of files in each of them.
+ */
+void benchGlob(int numDirs, int numFiles) {
+    char root[] = "/tmp/shellbench.XXXXXX";
+    char path[64];
+    char cwd[4096];
+    assert(mkdtemp(root) != NULL && getcwd(cwd, sizeof(cwd)) != NULL);
+    for (int d = 0; d < numDirs; d++) {
+        sprintf(path, "%s/d%d", root, d);
+        assert(mkdir(path, 0755) == 0);
+        for (int f = 0; f < numFiles; f++) {
+            sprintf(path, "%s/d%d/f%d", root, d, f);
+            close(open(path, O_CREAT | O_WRONLY, 0644));
+        }
+    }
+
+    int samplesHere = numSamples / 4 > 0 ? numSamples / 4 : 1;
+    double *samples = malloc(samplesHere * sizeof(*samples));
+    assert(chdir(root) == 0);
+    for (int s = 0; s < samplesHere; s++) {
+        DirectoryCache cache = {NULL, 0, 0};
+        int count = 0;
+        double start = nowNs();
+        matchWildcards(GLOB_PATTERN, &cache, countMatch, &count);
+        samples[s] = (nowNs() - start) / 1000;
+        freeDirectoryCache(&cache);
+        assert(count == numDirs * numFiles);
+    }
+    assert(chdir(cwd) == 0);
+
+    for (int d = 0; d < numDirs; d++) {
+        for (int f = 0; f < numFiles; f++) {
+            sprintf(path, "%s/d%d/f%d", root, d, f);
+            unlink(path);
+        }
+        sprintf(path, "%s/d%d", root, d);
+        rmdir(path);
+    }
+    rmdir(root);
+
+    char param[64];
+    sprintf(param, "dirs=%d files=%d", numDirs, numFiles);
+    report("glob " GLOB_PATTERN, param, samples, samplesHere, "us");
+    free(samples);
+}
+
+/**
+ * Builds an inputline with a pipeline of \param stages times TRUE_PROGRAM.
+ * @param stages number of commands in the pipeline.
+ * @return the line as a newly allocated string.
+ */
+char *makePipeline(int stages) {
+    char *line = malloc(stages * (strlen(TRUE_PROGRAM) + 3) + 1);
+    assert(line != NULL);
+    char *p = line;
+    for (int i = 0; i < stages; i++) {
+        p += sprintf(p, i == 0 ? "%s" : " | %s", TRUE_PROGRAM);
+    }
+    return line;
+}
+
+/**
+ * Measures the shell binary end to end: it runs a script of \param numLines copies of
+ * \param text with -f, and the throughput is reported in lines per second.
+ * @param name the name of the benchmark.
+ * @param text the line of the script.
+ * @param numLines number of lines in the script.
+ * @param mode the value for SHELL_LAUNCH.
+ */
+void benchEndToEnd(char *name, char *text, int numLines, char *mode) {
+    char path[] = "/tmp/shellbench.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd != -1);
+    for (int i = 0; i < numLines; i++) {
+        dprintf(fd, "%s\n", text);
+    }
+    close(fd);
+
+    int samplesHere = numSamples / 40 > 0 ? numSamples / 40 : 1;
+    double *samples = malloc(samplesHere * sizeof(*samples));
+    char *argv[] = {SHELL_BINARY, "-f", path, NULL};
+    setenv("SHELL_LAUNCH", mode, 1);
+
+    for (int s = 0; s < samplesHere; s++) {
+        pid_t pid;
+        int status;
+        double start = nowNs();
+        if (posix_spawn(&pid, SHELL_BINARY, NULL, NULL, argv, environ) != 0) {
+            printf("%s: cannot run %s, build it first\n", name, SHELL_BINARY);
+            samplesHere = 0;
+            break;
+        }
+        waitpid(pid, &status, 0);
+        samples[s] = numLines / ((nowNs() - start) / 1e9);
+    }
+    unlink(path);
+
+    if (samplesHere > 0) {
+        char param[64];
+        sprintf(param, "%s lines=%d", mode, numLines);
+        report(name, param, samples, samplesHere, "lines/s");
+    }
+    free(samples);
+}
+
+int main(int argc, char *argv[]) {
+    char *outFile = NULL;
+    char id[32];
+    int opt;
+
+    while ((opt = getopt(argc, argv, "n:o:")) != -1) {
+        switch (opt) {
+        case 'n':
+            numSamples = atoi(optarg);
+            break;
+        case 'o':
+            outFile = optarg;
+            break;
+        default:
+            fprintf(stderr, "Usage: %s [-n samples] [-o results.jsonl]\n", argv[0]);
+            exit(2);
+        }
+    }
+    if (numSamples < 1) {
+        numSamples = DEFAULT_SAMPLES;
+    }
+    if (outFile != NULL) {
+        jsonOut = fopen(outFile, "a");
+        if (jsonOut == NULL) {
+            perror(outFile);
+            exit(1);
+        }
+    }
+    sprintf(id, "%ld", (long)time(NULL));
+    runId = id;
+
+    bool haveZygote = startZygote();   // while the benchmark is still small
+    initExecutor();
+    printf("%-22s %-26s %12s %12s %12s\n", "benchmark", "parameters", "p50", "p99", "mean");
+
+    int lineLens[] = {16, 256, 4096};
+    for (int i = 0; i < 3; i++) {
+        benchReaderFile(100000 / (1 + lineLens[i] / 64), lineLens[i]);
+        benchReaderPipe(100000 / (1 + lineLens[i] / 64), lineLens[i]);
+    }
+
+    int tokenCounts[] = {10, 100, 1000, 10000, 100000};
+    for (int i = 0; i < 5; i++) {
+        benchTokenizer(tokenCounts[i], false);
+        benchTokenizer(tokenCounts[i], true);
+        benchParser(tokenCounts[i]);
+    }
+
+    char *operators[] = {";", "&&", "|"};
+    for (int i = 0; i < 3; i++) {
+        for (int numChains = 1000; numChains <= 1000000; numChains *= 10) {
+            benchParserStress(numChains, operators[i]);
+        }
+    }
+
+    benchGlob(8, 10);
+    benchGlob(100, 10);
+
+    LaunchMode modes[] = {LAUNCH_FORK, LAUNCH_SPAWN, LAUNCH_ZYGOTE};
+    int numModes = haveZygote ? 3 : 2;
+    int stageCounts[] = {2, 8, 20};
+    for (int m = 0; m < numModes; m++) {
+        benchLaunch("spawn latency", TRUE_PROGRAM, modes[m]);
+        benchLaunch("and-chain", TRUE_PROGRAM " && " TRUE_PROGRAM " && " TRUE_PROGRAM, modes[m]);
+        for (int i = 0; i < 3; i++) {
+            char name[32];
+            char *pipeline = makePipeline(stageCounts[i]);
+            sprintf(name, "pipeline stages=%d", stageCounts[i]);
+            benchLaunch(name, pipeline, modes[m]);
+            free(pipeline);
+        }
+    }
+
+    // the cost of creating a process from a shell that uses a lot of memory
+    char *heap = malloc(LARGE_HEAP_SIZE);
+    if (heap != NULL) {
+        memset(heap, 1, LARGE_HEAP_SIZE);
+        for (int m = 0; m < numModes; m++) {
+            benchLaunch("spawn latency 256MB", TRUE_PROGRAM, modes[m]);
+        }
+        free(heap);
+    }
+
+    for (int m = 0; m < 3; m++) {
+        benchEndToEnd("lines/sec simple", TRUE_PROGRAM, 1000, launchModeNames[m]);
+        benchEndToEnd("lines/sec and-chain", TRUE_PROGRAM " && " TRUE_PROGRAM, 500, launchModeNames[m]);
+        benchEndToEnd("lines/sec pipeline", TRUE_PROGRAM " | " TRUE_PROGRAM " | " TRUE_PROGRAM, 300,
+                      launchModeNames[m]);
+    }
+
+    if (jsonOut != NULL) {
+        fclose(jsonOut);
+    }
+    return 0;
+}
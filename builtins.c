@@ -0,0 +1,259 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "builtins.h"
+#include "exec.h"
+#include "pathcache.h"
+#include "jobs.h"
+#include "script.h"
+#include "utilities.h"
+#include "variables.h"
+
+/**
+ * The builtin exit terminates the shell.
+ * @param argv the argument list.
+ * @return does not return.
+ */
+int builtInExit(char **argv) {
+    exit(0);
+}
+
+/**
+ * The builtin status prints the exit code of the most recent command. "status -a" prints
+ * the exit codes of all parts of it, such as the lines of a parallel batch.
+ * @param argv the argument list.
+ * @return the most recent exit code, which is thereby left unchanged.
+ */
+int builtInStatus(char **argv) {
+    if (argv[1] != NULL && strcmp(argv[1], "-a") == 0) {
+        printf("The most recent exit codes are:");
+        for (int i = 0; i < numLastStatuses; i++) {
+            printf(" %d", lastStatuses[i]);
+        }
+        printf("\n");
+        return last;
+    }
+    printf("The most recent exit code is: %d\n", last);
+    return last;
+}
+
+/**
+ * The builtin cd changes the working directory of the shell.
+ * @param argv the argument list; argv[1] is the directory to navigate to.
+ * @return 0 on success, 2 when the directory is missing or cannot be entered.
+ */
+int builtInCd(char **argv) {
+    if (argv[1] == NULL) {
+        printf("Error: cd requires folder to navigate to!\n");
+        return 2;   // exit 2 for cd errors
+    }
+
+    // check directory exists
+    if (chdir(argv[1]) == -1) {
+        printf("Error: cd directory not found!\n");
+        return 2;
+    }
+    return 0;
+}
+
+/**
+ * The builtin hash prints the cached paths of commands. "hash -r" empties the cache and
+ * "hash name..." resolves the given names and adds them to the cache.
+ * @param argv the argument list.
+ * @return 0 on success, 1 when a name cannot be found.
+ */
+int builtInHash(char **argv) {
+    if (argv[1] == NULL) {
+        printPathCache();
+        return 0;
+    }
+    if (strcmp(argv[1], "-r") == 0) {
+        clearPathCache();
+        return 0;
+    }
+
+    int status = 0;
+    for (int i = 1; argv[i] != NULL; i++) {
+        if (lookupCommand(argv[i]) == NULL) {
+            printf("hash: %s: not found\n", argv[i]);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+/**
+ * The builtin jobs lists the background jobs.
+ * @param argv the argument list.
+ * @return 0.
+ */
+int builtInJobs(char **argv) {
+    printJobs();
+    return 0;
+}
+
+/**
+ * The builtin wait waits for the given jobs ("%n" or a pid), or for all jobs.
+ * @param argv the argument list.
+ * @return the exit code of the last job waited for, 127 when a job does not exist.
+ */
+int builtInWait(char **argv) {
+    if (argv[1] == NULL) {
+        return waitAllJobs();
+    }
+
+    int status = 0;
+    for (int i = 1; argv[i] != NULL; i++) {
+        Job *job = findJob(argv[i]);
+        if (job == NULL) {
+            printf("wait: %s: no such job\n", argv[i]);
+            status = 127;
+            continue;
+        }
+        status = waitJob(job);
+        removeJob(job);
+    }
+    return status;
+}
+
+/**
+ * The builtin fg brings a job (by default the most recent one) to the foreground: the
+ * shell waits for it as if it had been started without "&".
+ * @param argv the argument list.
+ * @return the exit code of the job, 1 when the job does not exist.
+ */
+int builtInFg(char **argv) {
+    Job *job = findJob(argv[1]);
+    if (job == NULL) {
+        printf("fg: %s: no such job\n", argv[1] == NULL ? "current" : argv[1]);
+        return 1;
+    }
+
+    printf("%s\n", job->command);
+    int status = waitJob(job);
+    removeJob(job);
+    return status;
+}
+
+/**
+ * The builtin parallel runs independent command lines concurrently: "parallel [-j N]
+ * [file]" executes the lines of the file (or of the remaining input of the shell) with at
+ * most N of them running at the same time. N defaults to the number of processors.
+ * @param argv the argument list.
+ * @return 0 when every line succeeded, otherwise the exit code of the first failing line.
+ */
+int builtInParallel(char **argv) {
+    int maxJobs = sysconf(_SC_NPROCESSORS_ONLN);
+    int i = 1;
+
+    if (argv[i] != NULL && strcmp(argv[i], "-j") == 0) {
+        if (argv[i + 1] == NULL || (maxJobs = atoi(argv[i + 1])) < 1) {
+            printf("parallel: invalid number of jobs\n");
+            return 2;
+        }
+        i += 2;
+    }
+
+    Script script;
+    if (argv[i] == NULL) {
+        readScript(&script, getStdinReader());
+    } else if (!loadScript(&script, argv[i])) {
+        printf("parallel: cannot open %s\n", argv[i]);
+        return 1;
+    }
+
+    int status;
+    if (validScript(&script)) {
+        status = runScriptParallel(&script, maxJobs);
+    } else {
+        printf("Error: invalid syntax!\n");
+        status = 2;
+    }
+    freeScript(&script);
+    return status;
+}
+
+/**
+ * The builtin export marks variables as exported, so that they are passed to the programs
+ * that the shell starts: "export NAME=value" also sets the variable. Without arguments,
+ * the exported variables are listed.
+ * @param argv the argument list.
+ * @return 0 on success, 1 when an argument is not a valid variable name.
+ */
+int builtInExport(char **argv) {
+    if (argv[1] == NULL) {
+        printExported();
+        return 0;
+    }
+
+    int status = 0;
+    for (int i = 1; argv[i] != NULL; i++) {
+        if (isAssignment(argv[i])) {
+            setVariable(argv[i], true);
+        } else if (variableNameLength(argv[i]) == strlen(argv[i]) && argv[i][0] != '\0') {
+            exportVariable(argv[i]);
+        } else {
+            printf("export: %s: not a valid identifier\n", argv[i]);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+/**
+ * The builtin exec replaces the shell with the program that its arguments name. The
+ * redirections of the builtin, which the shell has applied to itself already, are those
+ * of the program. Without arguments, the redirections stay in effect for the shell.
+ * @param argv the argument list.
+ * @return 0 without arguments, 127 when the program cannot be executed; does not return
+ * otherwise.
+ */
+int builtInExec(char **argv) {
+    if (argv[1] == NULL) {
+        return 0;
+    }
+
+    char *path = lookupCommand(argv[1]);
+    if (path != NULL) {
+        replaceShell(path, argv + 1);
+    }
+    printf("Error: command not found!\n");
+    return 127;
+}
+
+/**
+ * The builtin unset removes variables.
+ * @param argv the argument list.
+ * @return 0.
+ */
+int builtInUnset(char **argv) {
+    for (int i = 1; argv[i] != NULL; i++) {
+        unsetVariable(argv[i]);
+    }
+    return 0;
+}
+
+// NULL-terminated array makes it easy to expand this array later
+// without changing the code at other places.
+BuiltIn builtIns[] = {
+    {"exit", builtInExit, false},
+    {"status", builtInStatus, false},
+    {"cd", builtInCd, false},
+    {"hash", builtInHash, false},
+    {"jobs", builtInJobs, false},
+    {"wait", builtInWait, false},
+    {"fg", builtInFg, false},
+    {"parallel", builtInParallel, false},
+    {"export", builtInExport, false},
+    {"unset", builtInUnset, false},
+    {"exec", builtInExec, false},
+    {"true", builtInTrue, true},
+    {"false", builtInFalse, true},
+    {"echo", builtInEcho, true},
+    {"printf", builtInPrintf, true},
+    {"test", builtInTest, true},
+    {"[", builtInTest, true},
+    {NULL, NULL, false}
+};
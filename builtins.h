@@ -0,0 +1,20 @@
+#ifndef SHELL_BUILTINS_H
+#define SHELL_BUILTINS_H
+
+#include <stdbool.h>
+
+// a builtin gets the NULL-terminated argument list and returns its exit code
+typedef int (*BuiltInFunction)(char **argv);
+
+typedef struct BuiltIn {
+    char *name;
+    BuiltInFunction function;
+    bool utility;   // an ordinary command, which can be redirected and used in a pipeline
+} BuiltIn;
+
+extern BuiltIn builtIns[];
+
+// the shell keeps the redirections of exec without a command
+int builtInExec(char **argv);
+
+#endif
@@ -0,0 +1,1340 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <spawn.h>
+#include <sys/mman.h>
+
+#include "scanner.h"
+#include "shell.h"
+#include "exec.h"
+#include "pathcache.h"
+#include "jobs.h"
+#include "relay.h"
+#include "trace.h"
+#include "zygote.h"
+#include "expand.h"
+#include "variables.h"
+
+// variable for the exit code of the last command executed
+int last = 0;
+
+// how child processes are created
+LaunchMode launchMode = LAUNCH_SPAWN;
+
+// the exit codes of the parts of the most recent command
+int *lastStatuses = NULL;
+int numLastStatuses = 0;
+int lastStatusesSize = 0;
+
+// whether the process exits once the list that it runs is done, as a forked child does.
+// The program of the final chain of the list then replaces the process instead of running
+// in a child of its own
+bool lastInProcess = false;
+
+// groups run chains themselves
+void runCompound(Command *cmd, bool final);
+
+/**
+ * Initialises the executor. The environment variable SHELL_LAUNCH selects how child
+ * processes are created: "spawn" (the default) uses posix_spawn, "fork" uses fork and
+ * execvp, and "zygote" lets a helper process that is forked right now start them. The
+ * environment variable SHELL_TRACE names a file that the timings of every command are
+ * appended to.
+ */
+void initExecutor(){
+    char *mode = getenv("SHELL_LAUNCH");
+
+    if (mode != NULL && strcmp(mode, "fork") == 0){
+        launchMode = LAUNCH_FORK;
+    }else if (mode != NULL && strcmp(mode, "spawn") == 0){
+        launchMode = LAUNCH_SPAWN;
+    }else if (mode != NULL && strcmp(mode, "zygote") == 0){
+        // before anything else, so that the zygote is as small as possible
+        launchMode = startZygote() ? LAUNCH_ZYGOTE : LAUNCH_SPAWN;
+    }
+
+    initJobs();
+    initTrace();
+}
+
+/**
+ * Makes room for \param n exit codes in lastStatuses.
+ * @param n the number of exit codes.
+ */
+void setLastStatuses(int n){
+    if (n > lastStatusesSize){
+        lastStatusesSize = n;
+        lastStatuses = realloc(lastStatuses, n * sizeof(*lastStatuses));
+        assert(lastStatuses != NULL);
+    }
+    numLastStatuses = n;
+}
+
+/**
+ * Checks whether chain \param chain reads from a file that it also writes to, which
+ * would truncate the input before it is read.
+ * @param chain the chain.
+ * @return a bool denoting whether the redirections conflict.
+ */
+bool sameRedirections(Chain *chain){
+    for (Command *in = chain->commands; in != NULL; in = in->next){
+        for (Redirection *r = in->redirections; r != NULL; r = r->next){
+            if (r->type != REDIRECT_INPUT) continue;
+
+            for (Command *out = chain->commands; out != NULL; out = out->next){
+                for (Redirection *w = out->redirections; w != NULL; w = w->next){
+                    if ((w->type == REDIRECT_OUTPUT || w->type == REDIRECT_APPEND) &&
+                        strcmp(r->word, w->word) == 0){
+                        return true;
+                    }
+                }
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Checks whether command \param cmd runs shell code instead of executing a program: a
+ * relay, a builtin, a group or assignments in a pipeline. Such a command needs a forked
+ * copy of the shell.
+ * @param cmd the command.
+ * @return a bool denoting whether the command does not execute a program.
+ */
+bool runsInShell(Command *cmd){
+    return cmd->relayFile != NULL || cmd->builtIn != NULL || cmd->compound != NULL || cmd->numWords == 0;
+}
+
+/**
+ * Expands the assignments of command \param cmd.
+ * @param cmd the command, which has assignments.
+ * @param n set to the number of assignments.
+ * @return the assignments, "NAME=value", as newly allocated strings in a newly allocated
+ * array; release them with freeAssignments.
+ */
+char **expandAssignments(Command *cmd, int *n){
+    *n = 0;
+    for (Assignment *a = cmd->assignments; a != NULL; a = a->next){
+        (*n)++;
+    }
+
+    char **texts = malloc(*n * sizeof(*texts));
+    assert(texts != NULL);
+    int i = 0;
+    for (Assignment *a = cmd->assignments; a != NULL; a = a->next){
+        texts[i++] = a->expand ? expandText(a->word) : strdup(a->word);
+    }
+    return texts;
+}
+
+/**
+ * Releases the assignments that expandAssignments returned.
+ * @param texts the assignments.
+ * @param n the number of assignments.
+ */
+void freeAssignments(char **texts, int n){
+    for (int i = 0; i < n; i++){
+        free(texts[i]);
+    }
+    free(texts);
+}
+
+/**
+ * Applies the assignments of command \param cmd to the variables of the shell.
+ * @param cmd the command.
+ * @param export whether the variables become exported, as they do in the environment of
+ * a program that is about to be executed.
+ */
+void applyAssignments(Command *cmd, bool export){
+    int n;
+
+    if (cmd->assignments == NULL){
+        return;
+    }
+    char **texts = expandAssignments(cmd, &n);
+    for (int i = 0; i < n; i++){
+        setVariable(texts[i], export);
+    }
+    freeAssignments(texts, n);
+}
+
+/**
+ * Checks whether command \param cmd is started by the zygote, and therefore has to be
+ * waited for by the zygote as well.
+ * @param cmd the command.
+ * @return a bool denoting whether the zygote starts the command.
+ */
+bool usesZygote(Command *cmd){
+    return launchMode == LAUNCH_ZYGOTE && !runsInShell(cmd) && zygoteAvailable();
+}
+
+/**
+ * Opens the file of a redirection in the shell itself, so that the shell can report errors
+ * whichever way the child is created.
+ * @param fileName the file to open.
+ * @param flags the flags for open.
+ * @return the file descriptor, or -1 when the file cannot be opened.
+ */
+int openRedirection(char *fileName, int flags){
+    int fd = open(fileName, flags | O_CLOEXEC, 0644);
+
+    if (fd < 0){
+        printf("Error in open\n");
+        last = 1;
+    }
+    return fd;
+}
+
+/**
+ * Creates a file descriptor that reads the body of a here-string or here-document. A body
+ * that fits in the buffer of a pipe is written into a pipe; a larger one into a memory
+ * file, because nobody would read the pipe while the shell is still writing it.
+ * @param body the body.
+ * @param length the length of \param body.
+ * @return the file descriptor, or -1 when it could not be created.
+ */
+int bodyDescriptor(char *body, size_t length){
+    int fds[2];
+
+    if (length <= PIPE_BUF){
+        if (pipe2(fds, O_CLOEXEC) == -1){
+            return -1;
+        }
+        if (!writeAll(fds[1], body, length)){
+            close(fds[0]);
+            fds[0] = -1;
+        }
+        close(fds[1]);
+        return fds[0];
+    }
+
+    int fd = memfd_create("here-document", MFD_CLOEXEC);
+    if (fd != -1 && (!writeAll(fd, body, length) || lseek(fd, 0, SEEK_SET) == -1)){
+        close(fd);
+        fd = -1;
+    }
+    return fd;
+}
+
+/**
+ * Closes file descriptor \param fd when it was opened for child \param cf and none of
+ * the standard descriptors of the child refers to it any more.
+ * @param cf the descriptors of the child.
+ * @param fd the file descriptor.
+ */
+void releaseChildFd(ChildFds *cf, int fd){
+    for (int i = 0; i < STANDARD_FDS; i++){
+        if (cf->fds[i] == fd) return;
+    }
+    for (int i = 0; i < cf->numOpened; i++){
+        if (cf->opened[i] == fd){
+            close(fd);
+            cf->opened[i] = cf->opened[--cf->numOpened];
+            return;
+        }
+    }
+}
+
+/**
+ * Makes file descriptor \param fd standard descriptor \param i of child \param cf.
+ * @param cf the descriptors of the child.
+ * @param i the standard descriptor.
+ * @param fd the file descriptor.
+ * @param opened whether \param fd was opened for the child, so that it has to be closed.
+ */
+void setChildFd(ChildFds *cf, int i, int fd, bool opened){
+    int old = cf->fds[i];
+
+    cf->fds[i] = fd;
+    if (opened){
+        cf->opened[cf->numOpened++] = fd;
+    }
+    releaseChildFd(cf, old);
+}
+
+/**
+ * Closes the file descriptors that prepareChildFds opened for child \param cf.
+ * @param cf the descriptors of the child.
+ */
+void closeChildFds(ChildFds *cf){
+    for (int i = 0; i < cf->numOpened; i++){
+        close(cf->opened[i]);
+    }
+    cf->numOpened = 0;
+}
+
+/**
+ * Determines the stdin, stdout and stderr of a child that runs command \param cmd: the
+ * pipe ends \param inFd and \param outFd, overridden by the redirections of the command
+ * in order. Files are opened, and here-documents written, by the shell; every descriptor
+ * that is opened is close-on-exec, so the child only keeps its standard descriptors.
+ * Afterwards, no standard descriptor of the child refers to another standard descriptor
+ * of the shell, so they can be put in place one after the other.
+ * @param cmd the command.
+ * @param inFd file descriptor that becomes stdin of the child, or -1.
+ * @param outFd file descriptor that becomes stdout of the child, or -1.
+ * @param cf where the descriptors are stored.
+ * @return a bool denoting whether all redirections could be applied; otherwise nothing
+ * is left open.
+ */
+bool prepareChildFds(Command *cmd, int inFd, int outFd, ChildFds *cf){
+    cf->fds[0] = inFd != -1 ? inFd : STDIN_FILENO;
+    cf->fds[1] = outFd != -1 ? outFd : STDOUT_FILENO;
+    cf->fds[2] = STDERR_FILENO;
+    cf->numOpened = 0;
+
+    for (Redirection *r = cmd->redirections; r != NULL; r = r->next){
+        bool expanded = r->expand && r->type != REDIRECT_HEREDOC;
+        char *word = expanded ? expandText(r->word) : r->word;
+        int fd;
+
+        switch (r->type){
+        case REDIRECT_INPUT:
+            fd = openRedirection(word, O_RDONLY);
+            break;
+        case REDIRECT_OUTPUT:
+            fd = openRedirection(word, O_CREAT | O_TRUNC | O_WRONLY);  // create file if it doesn't exist, truncate if it does
+            break;
+        case REDIRECT_APPEND:
+            fd = openRedirection(word, O_CREAT | O_APPEND | O_WRONLY);
+            break;
+        case REDIRECT_STRING:
+            if (r->expand){ // the body is only known now
+                size_t n = strlen(word);
+                word = realloc(word, n + 1);
+                assert(word != NULL);
+                word[n] = '\n';
+                fd = bodyDescriptor(word, n + 1);
+            }else{
+                fd = bodyDescriptor(r->body, r->bodyLength);
+            }
+            if (fd == -1){
+                printf("Error in pipe\n");
+                last = 1;
+            }
+            break;
+        case REDIRECT_DUPLICATE:
+            setChildFd(cf, r->fd, cf->fds[r->sourceFd], false);
+            continue;
+        default:    // a here-document
+            if (r->expand){ // its body is expanded every time it is opened
+                size_t n = r->bodyLength;
+                char *body = expandBody(r->body, &n);
+                fd = bodyDescriptor(body, n);
+                free(body);
+            }else{
+                fd = bodyDescriptor(r->body, r->bodyLength);
+            }
+            if (fd == -1){
+                printf("Error in pipe\n");
+                last = 1;
+            }
+            break;
+        }
+        if (expanded){
+            free(word);
+        }
+        if (fd == -1){
+            closeChildFds(cf);
+            return false;
+        }
+        setChildFd(cf, r->fd, fd, true);
+    }
+
+    for (int i = 0; i < STANDARD_FDS; i++){
+        int fd = cf->fds[i];
+        if (fd < STANDARD_FDS && fd != i){
+            int copy = fcntl(fd, F_DUPFD_CLOEXEC, SAVED_FD_MIN);
+            if (copy == -1){
+                printf("Error in dup\n");
+                last = 1;
+                closeChildFds(cf);
+                return false;
+            }
+            for (int j = i; j < STANDARD_FDS; j++){
+                if (cf->fds[j] == fd) cf->fds[j] = copy;
+            }
+            cf->opened[cf->numOpened++] = copy;
+        }
+    }
+    return true;
+}
+
+/**
+ * Executes command \param cmd in the current (child) process.
+ * @param cmd the command.
+ * @param path the resolved path of the executable, or NULL when it was not found.
+ * @param errorFd where the errno of a failed execve is written, or -1.
+ */
+void execCommand(Command *cmd, char *path, int errorFd){
+    if (path != NULL){
+        executePath(path, cmd->argv, environ);
+        int error = errno;
+        if (errorFd != -1 && write(errorFd, &error, sizeof(error)) != sizeof(error)){
+            // the shell then keeps the cached path
+        }
+    }
+
+    // If execv() succeeds, this code will not be reached.
+    printf("Error: command not found!\n");
+    fflush(stdout);
+    _exit(127);
+}
+
+/**
+ * Runs relay \param relay in the current (child) process: everything that arrives on
+ * stdin is copied to the relay file and to stdout.
+ * @param relay the relay.
+ */
+void runRelay(Command *relay){
+    int fileFd = open(relay->relayFile, O_CREAT | O_TRUNC | O_WRONLY, 0644);
+
+    if (fileFd < 0){
+        printf("Error in open\n");
+        fflush(stdout);
+        _exit(1);
+    }
+    _exit(relayData(STDIN_FILENO, STDOUT_FILENO, fileFd));
+}
+
+/**
+ * Creates a child process with fork that runs command \param cmd.
+ * @param cmd the command.
+ * @param inFd file descriptor that becomes stdin of the child, or -1.
+ * @param outFd file descriptor that becomes stdout of the child, or -1.
+ * @param cf the descriptors that become stdin, stdout and stderr of the child.
+ * @param timing where the moment that the child executes its program is recorded, or
+ * NULL. The shell waits until the child closes a close-on-exec pipe, through which it
+ * reports the errno of a failed execve; the cached path is then forgotten.
+ * @return the pid of the child, or -1 when no child was created.
+ */
+pid_t forkCommand(Command *cmd, int inFd, int outFd, ChildFds *cf, CommandTiming *timing){
+    char *path = runsInShell(cmd) ? NULL : lookupCommand(cmd->argv[0]);
+    int execPipe[2] = {-1, -1};
+
+    // only a program reports whether it could be executed; shell code never executes one
+    if (path != NULL && pipe2(execPipe, O_CLOEXEC) == -1){
+        execPipe[0] = execPipe[1] = -1;
+    }
+    pid_t pid = fork();
+
+    if (pid == -1){
+        printf("Error in fork\n");
+        if (execPipe[0] != -1){
+            close(execPipe[0]);
+            close(execPipe[1]);
+        }
+        return -1;
+    }
+
+    if (pid == 0){ // Child process
+        for (int i = 0; i < STANDARD_FDS; i++){
+            if (cf->fds[i] != i) dup2(cf->fds[i], i);
+        }
+        // shell code does not execute, so close-on-exec does not close the pipe ends
+        closeChildFds(cf);
+        if (inFd != -1) close(inFd);
+        if (outFd != -1) close(outFd);
+
+        applyAssignments(cmd, true);
+        shellEnvironment();
+        if (cmd->relayFile != NULL){
+            runRelay(cmd);
+        }
+        if (cmd->compound != NULL){
+            runCompound(cmd, true);
+            fflush(stdout);
+            _exit(last);
+        }
+        if (cmd->numWords == 0){
+            _exit(0);
+        }
+        if (cmd->builtIn != NULL){
+            int code = cmd->builtIn->function(cmd->argv);
+            fflush(stdout);
+            _exit(code);
+        }
+        execCommand(cmd, path, execPipe[1]);
+    }
+
+    if (execPipe[0] != -1){ // read returns 0 once the child has executed or terminated
+        int error;
+        ssize_t n;
+        close(execPipe[1]);
+        while ((n = read(execPipe[0], &error, sizeof(error))) == -1 && errno == EINTR){
+        }
+        close(execPipe[0]);
+        if (n == sizeof(error)){    // the cached executable is gone
+            forgetCommand(cmd->argv[0]);
+        }
+    }
+    if (timing != NULL){
+        markTime(&timing->execed);
+    }
+    return pid;
+}
+
+/**
+ * Starts program \param path for command \param cmd: through the zygote when it is used,
+ * otherwise with posix_spawn. The redirections and pipe ends are passed as file actions
+ * (or to the zygote) instead of being set up by a forked copy of the shell, so the
+ * address space of the shell is never copied.
+ * @param cmd the command.
+ * @param path the resolved path of the executable.
+ * @param cf the descriptors that become stdin, stdout and stderr of the child.
+ * @param envp the environment of the child.
+ * @return the pid of the child, or -1 when the program could not be executed.
+ */
+pid_t startProgram(Command *cmd, char *path, ChildFds *cf, char **envp){
+    pid_t pid;
+
+    if (usesZygote(cmd)){
+        pid = zygoteSpawn(path, cmd->argv, cf->fds, envp);
+        if (pid != -1 || zygoteAvailable()){
+            return pid;
+        }
+        // the zygote is gone: the shell starts its children itself from now on
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    for (int i = 0; i < STANDARD_FDS; i++){  // the sources are close-on-exec
+        if (cf->fds[i] != i){
+            posix_spawn_file_actions_adddup2(&actions, cf->fds[i], i);
+        }
+    }
+    int error = posix_spawn(&pid, path, &actions, NULL, cmd->argv, envp);
+    if (error == ENOEXEC){  // not a binary nor a "#!" script, which execvp gives to the shell
+        char **args = scriptArguments(path, cmd->argv);
+        error = posix_spawn(&pid, FALLBACK_SHELL, &actions, NULL, args, envp);
+        free(args);
+    }
+    if (error != 0){
+        pid = -1;
+    }
+    posix_spawn_file_actions_destroy(&actions);
+    return pid;
+}
+
+/**
+ * Creates a child process without forking the shell that runs command \param cmd. The
+ * assignments of the command are added to the environment of the child only.
+ * @param cmd the command.
+ * @param cf the descriptors that become stdin, stdout and stderr of the child.
+ * @param timing where the moment that the child executes its program is recorded, or
+ * NULL. Both posix_spawn and the zygote only return once the child has executed the
+ * program.
+ * @return the pid of the child, or -1 when no child was created.
+ */
+pid_t spawnCommand(Command *cmd, ChildFds *cf, CommandTiming *timing){
+    pid_t pid = -1;
+
+    char **envp = environ;
+    char **texts = NULL;
+    int n = 0;
+    if (cmd->assignments != NULL){
+        texts = expandAssignments(cmd, &n);
+        envp = environmentWith(texts, n);
+    }
+
+    char *path = lookupCommand(cmd->argv[0]);
+    if (path == NULL || (pid = startProgram(cmd, path, cf, envp)) == -1){
+        if (path != NULL){  // the cached executable is gone
+            forgetCommand(cmd->argv[0]);
+        }
+        printf("Error: command not found!\n");
+        last = 127;
+        pid = -1;
+    }else if (timing != NULL){
+        markTime(&timing->execed);
+    }
+
+    if (texts != NULL){
+        free(envp);
+        freeAssignments(texts, n);
+    }
+    return pid;
+}
+
+/**
+ * Creates a child process that runs command \param cmd with its redirections, using the
+ * selected launch mode.
+ * @param cmd the command.
+ * @param inFd file descriptor that becomes stdin of the child, or -1.
+ * @param outFd file descriptor that becomes stdout of the child, or -1.
+ * @param timing where the timings of the command are recorded, or NULL.
+ * @return the pid of the child, or -1 when no child was created.
+ */
+pid_t launchCommand(Command *cmd, int inFd, int outFd, CommandTiming *timing){
+    ChildFds cf;
+    pid_t pid;
+
+    fflush(stdout);         // what the shell printed comes before the output of the child
+    syncInput();
+    shellEnvironment();     // environ is only rebuilt when an exported variable changed
+    if (timing != NULL){
+        markTime(&timing->launched);
+    }
+    if (!prepareChildFds(cmd, inFd, outFd, &cf)){
+        pid = -1;
+    }else if (launchMode != LAUNCH_FORK && !runsInShell(cmd)){
+        pid = spawnCommand(cmd, &cf, timing);
+    }else{
+        pid = forkCommand(cmd, inFd, outFd, &cf, timing);
+    }
+    closeChildFds(&cf);
+    if (timing != NULL){
+        timing->pid = pid;
+    }
+    return pid;
+}
+
+/**
+ * Writes redirection \param r to \param p the way it was written, preceded by a space.
+ * The descriptor is only written when it is not the default one of the operator.
+ * @param p where the text is written.
+ * @param r the redirection.
+ * @return the number of characters written.
+ */
+int formatRedirection(char *p, Redirection *r){
+    char *operators[] = {"<", ">", ">>", ">&", "<<<", "<<"};
+    char *op = operators[r->type];
+
+    if (r->type == REDIRECT_DUPLICATE && r->fd == 0){
+        op = "<&";
+    }
+    int defaultFd = op[0] == '<' ? 0 : 1;
+    if (r->fd != defaultFd){
+        return sprintf(p, " %d%s %s", r->fd, op, r->word);
+    }
+    return sprintf(p, " %s %s", op, r->word);
+}
+
+/**
+ * Builds the text of the chains \param first up to and including \param end, the way
+ * the jobs builtin shows them.
+ * @param first the first chain.
+ * @param end the last chain.
+ * @return the text as a newly allocated string.
+ */
+char *formatChains(Chain *first, Chain *end){
+    size_t len = 1;
+    for (Chain *chain = first; ; chain = chain->next){
+        for (Command *cmd = chain->commands; cmd != NULL; cmd = cmd->next){
+            for (int i = 0; i < cmd->argc; i++){
+                len += strlen(cmd->argv[i]) + 1;
+            }
+            len += (cmd->relayFile != NULL ? strlen(cmd->relayFile) + 3 : 0) + 3;
+            for (Redirection *r = cmd->redirections; r != NULL; r = r->next){
+                len += strlen(r->word) + 7;
+            }
+        }
+        len += 9;
+        if (chain == end) break;
+    }
+
+    char *text = malloc(len);
+    assert(text != NULL);
+    char *p = text;
+    for (Chain *chain = first; ; chain = chain->next){
+        if (chain->timed){
+            p += sprintf(p, "time ");
+        }
+        for (Command *cmd = chain->commands; cmd != NULL; cmd = cmd->next){
+            for (int i = 0; i < cmd->argc; i++){
+                p += sprintf(p, i == 0 ? "%s" : " %s", cmd->argv[i]);
+            }
+            if (cmd->relayFile != NULL){
+                p += sprintf(p, "|& %s", cmd->relayFile);
+            }
+            for (Redirection *r = cmd->redirections; r != NULL; r = r->next){
+                p += formatRedirection(p, r);
+            }
+            if (cmd->next != NULL){
+                p += sprintf(p, cmd->next->relayFile != NULL ? " " : " | ");
+            }
+        }
+        if (chain == end) break;
+        p += sprintf(p, chain->op == OP_AND ? " && " : " || ");
+    }
+    return text;
+}
+
+/**
+ * Registers processes \param pids, which run chains \param first up to \param end in the
+ * background, as a job. Starting a job counts as a successful command.
+ * @param first the first chain of the job.
+ * @param end the last chain of the job.
+ * @param pids the processes of the job; the job takes ownership.
+ * @param numPids number of processes.
+ */
+void startJob(Chain *first, Chain *end, pid_t *pids, int numPids){
+    addJob(pids, numPids, formatChains(first, end));
+    last = 0;
+}
+
+/**
+ * Waits for child \param pid of command \param cmd and returns its exit code.
+ * @param pid the child.
+ * @param cmd the command that the child executes.
+ * @param timing where the time of termination and the resource usage of the child are
+ * recorded, or NULL. When the child cannot be waited for, its pid is set to -1 there, so
+ * that the command is not reported.
+ * @return the exit code, or 128 plus the signal number when the child was killed; 1 when
+ * it cannot be waited for.
+ */
+int waitCommand(pid_t pid, Command *cmd, CommandTiming *timing){
+    int status;
+    struct rusage usage;
+    bool waited;
+
+    if (usesZygote(cmd)){
+        waited = zygoteWait(pid, &status, &usage);
+    }else{
+        do {
+            waited = wait4(pid, &status, 0, &usage) != -1;
+        } while (!waited && errno == EINTR);
+    }
+    if (!waited){
+        if (timing != NULL){
+            timing->pid = -1;
+        }
+        return 1;
+    }
+    if (timing != NULL){
+        markTime(&timing->exited);
+        timing->usage = usage;
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+/**
+ * Runs a chain that consists of a single executable.
+ * @param chain the chain.
+ * @param background whether the shell does not wait for the command.
+ */
+void runCommand(Chain *chain, bool background){
+    CommandTiming timing;
+    CommandTiming *tp = !background && (chain->timed || tracing()) ? &timing : NULL;
+    pid_t pid = launchCommand(chain->commands, -1, -1, tp);
+
+    if (pid != -1 && background){
+        pid_t *pids = malloc(sizeof(*pids));
+        assert(pids != NULL);
+        pids[0] = pid;
+        startJob(chain, chain, pids, 1);
+    }else if (pid != -1){
+        last = waitCommand(pid, chain->commands, tp);
+    }
+    setLastStatuses(1);
+    lastStatuses[0] = last;
+
+    if (tp != NULL){
+        reportTimings(chain, tp, lastStatuses, 1);
+    }
+}
+
+/**
+ * Runs a chain that consists of a pipeline of several executables. The pipe between two
+ * commands is created just before the first of them is started, and the shell closes
+ * each pipe end as soon as the child that needs it has been started, so at most two pipes
+ * are open in the shell however long the pipeline is. All pipes are close-on-exec: a
+ * child only keeps the ends that were moved onto its stdin and stdout, so every reader
+ * sees EOF as soon as its writer terminates. The shell waits for the children in
+ * pipeline order and stores the exit code of every command in lastStatuses; when the
+ * pipeline is timed or traced, the timings of every stage are reported as well.
+ * @param chain the chain.
+ * @param background whether the shell does not wait for the pipeline.
+ */
+void runPipeline(Chain *chain, bool background){
+    int pipefd[2];  //fd[0] for input (read end), fd[1] for output (write end)
+    int prevRead = -1;
+    pid_t *pids = malloc(chain->numCommands * sizeof(*pids));
+    assert(pids != NULL);
+    CommandTiming *timings = NULL;
+    Command *curr = chain->commands;
+
+    if (!background && (chain->timed || tracing())){
+        timings = malloc(chain->numCommands * sizeof(*timings));
+        assert(timings != NULL);
+    }
+
+    setLastStatuses(chain->numCommands);
+    for (int i = 0; i < chain->numCommands; i++, curr = curr->next){
+        bool lastCommand = i == chain->numCommands - 1;
+
+        // Create the pipe to the next command
+        pipefd[0] = pipefd[1] = -1;
+        if (!lastCommand && pipe2(pipefd, O_CLOEXEC) == -1){
+            printf("Error in pipe\n");
+            lastCommand = true;
+        }
+
+        // Redirect stdin to read end of previous pipe, and stdout to write end of current pipe
+        pids[i] = launchCommand(curr, prevRead, pipefd[1], timings != NULL ? &timings[i] : NULL);
+        lastStatuses[i] = last;     // the exit code if the command could not be started
+
+        // the ends that were handed to the child are not needed by the shell
+        if (prevRead != -1) close(prevRead);
+        if (pipefd[1] != -1) close(pipefd[1]);
+        prevRead = pipefd[0];
+
+        if (lastCommand && i != chain->numCommands - 1){   // the pipeline is cut short
+            setLastStatuses(i + 1);
+            break;
+        }
+    }
+    if (prevRead != -1) close(prevRead);
+
+    if (background){
+        int numPids = 0;
+        for (int i = 0; i < numLastStatuses; i++){
+            if (pids[i] != -1) pids[numPids++] = pids[i];
+        }
+        startJob(chain, chain, pids, numPids);
+        return;
+    }
+
+    //waiting for all child processes to finish, in pipeline order
+    curr = chain->commands;
+    for (int i = 0; i < numLastStatuses; i++, curr = curr->next){
+        if (pids[i] != -1){
+            lastStatuses[i] = waitCommand(pids[i], curr, timings != NULL ? &timings[i] : NULL);
+        }
+    }
+    last = lastStatuses[numLastStatuses - 1];
+    free(pids);
+
+    if (timings != NULL){
+        reportTimings(chain, timings, lastStatuses, numLastStatuses);
+        free(timings);
+    }
+}
+
+/**
+ * Applies the redirections of command \param cmd to the shell itself, so that a builtin
+ * can run without a child process. The original stdin, stdout and stderr are kept in
+ * \param saved (or -1 when they are not redirected) until restoreRedirections puts them
+ * back.
+ * @param cmd the command.
+ * @param saved where the original stdin, stdout and stderr are stored.
+ * @return a bool denoting whether the redirections were applied; when a file cannot be
+ * opened, nothing is redirected.
+ */
+bool redirectShell(Command *cmd, int saved[STANDARD_FDS]){
+    ChildFds cf;
+
+    for (int i = 0; i < STANDARD_FDS; i++){
+        saved[i] = -1;
+    }
+    if (cmd->redirections == NULL){
+        return true;
+    }
+    if (!prepareChildFds(cmd, -1, -1, &cf)){
+        return false;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < STANDARD_FDS; i++){
+        if (cf.fds[i] != i){
+            saved[i] = fcntl(i, F_DUPFD_CLOEXEC, SAVED_FD_MIN);
+            dup2(cf.fds[i], i);
+        }
+    }
+    closeChildFds(&cf);
+    return true;
+}
+
+/**
+ * Makes the redirections that redirectShell applied permanent, by closing the original
+ * stdin, stdout and stderr that it saved in \param saved.
+ * @param saved the original stdin, stdout and stderr, or -1.
+ */
+void keepRedirections(int saved[STANDARD_FDS]){
+    for (int i = 0; i < STANDARD_FDS; i++){
+        if (saved[i] != -1){
+            close(saved[i]);
+        }
+    }
+}
+
+/**
+ * Puts back the stdin, stdout and stderr of the shell that redirectShell saved in
+ * \param saved.
+ * @param saved the original stdin, stdout and stderr, or -1.
+ */
+void restoreRedirections(int saved[STANDARD_FDS]){
+    fflush(stdout);
+    fflush(stderr);
+    for (int i = 0; i < STANDARD_FDS; i++){
+        if (saved[i] != -1){
+            dup2(saved[i], i);
+            close(saved[i]);
+        }
+    }
+}
+
+/**
+ * Determines the resources that the shell and the children that it waited for have used
+ * so far.
+ * @param usage where the resources are stored.
+ */
+void shellUsage(struct rusage *usage){
+    struct rusage children;
+
+    getrusage(RUSAGE_SELF, usage);
+    getrusage(RUSAGE_CHILDREN, &children);
+    timeradd(&usage->ru_utime, &children.ru_utime, &usage->ru_utime);
+    timeradd(&usage->ru_stime, &children.ru_stime, &usage->ru_stime);
+    if (children.ru_maxrss > usage->ru_maxrss){
+        usage->ru_maxrss = children.ru_maxrss;
+    }
+}
+
+/**
+ * Runs chain \param chain in the shell itself by calling \param run. When the chain is
+ * timed or traced, the resources that the shell and its children used meanwhile are
+ * reported.
+ * @param chain the chain.
+ * @param run the function that runs the chain.
+ */
+void timeInShell(Chain *chain, void (*run)(Chain *)){
+    if (!chain->timed && !tracing()){
+        run(chain);
+        return;
+    }
+
+    CommandTiming timing;
+    struct rusage before;
+    shellUsage(&before);
+    markTime(&timing.launched);
+    timing.execed = timing.launched;
+    timing.pid = 0;
+
+    run(chain);
+
+    markTime(&timing.exited);
+    shellUsage(&timing.usage);
+    timersub(&timing.usage.ru_utime, &before.ru_utime, &timing.usage.ru_utime);
+    timersub(&timing.usage.ru_stime, &before.ru_stime, &timing.usage.ru_stime);
+    reportTimings(chain, &timing, &last, 1);
+}
+
+/**
+ * Calls the builtin of chain \param chain.
+ * @param chain the chain.
+ */
+void callBuiltIn(Chain *chain){
+    Command *cmd = chain->commands;
+    last = cmd->builtIn->function(cmd->argv);
+}
+
+/**
+ * Runs the builtin of chain \param chain in the shell itself. Its redirections are
+ * applied to the shell for the duration of the builtin.
+ * @param chain the chain.
+ */
+void runBuiltIn(Chain *chain){
+    Command *cmd = chain->commands;
+    int saved[STANDARD_FDS];
+
+    if (redirectShell(cmd, saved)){
+        timeInShell(chain, callBuiltIn);
+        if (cmd->builtIn->function == builtInExec && cmd->argc == 1){
+            keepRedirections(saved);
+        }else{
+            restoreRedirections(saved);
+        }
+    }
+}
+
+// compound commands contain lists themselves
+bool changesShell(Chain *first);
+
+/**
+ * Checks whether compound command \param compound can change the state of the shell, as
+ * changesShell does for its lists. A for loop assigns its variable; a subshell cannot
+ * change anything.
+ * @param compound the compound command.
+ * @return a bool denoting whether the compound command changes the shell.
+ */
+bool compoundChangesShell(Compound *compound){
+    if (compound->type == COMPOUND_SUBSHELL){
+        return false;
+    }
+    if (compound->type == COMPOUND_FOR){
+        return true;
+    }
+    return changesShell(compound->condition) || changesShell(compound->body) ||
+           changesShell(compound->elseBody) ||
+           (compound->elseIf != NULL && compoundChangesShell(compound->elseIf));
+}
+
+/**
+ * Checks whether the chains from \param first on can change the state of the shell:
+ * builtins such as cd, assignments, and background jobs, which would become jobs of the
+ * shell. Compound commands are checked as well.
+ * @param first the first chain.
+ * @return a bool denoting whether the chains need a process of their own to run in a
+ * subshell.
+ */
+bool changesShell(Chain *first){
+    for (Chain *chain = first; chain != NULL; chain = chain->next){
+        if (chain->op == OP_BACKGROUND){
+            return true;
+        }
+        for (Command *cmd = chain->commands; cmd != NULL; cmd = cmd->next){
+            if ((cmd->builtIn != NULL && !cmd->builtIn->utility) || cmd->numWords == 0){
+                return true;
+            }
+            if (cmd->compound != NULL && compoundChangesShell(cmd->compound)){
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Checks whether chain \param chain is the last one that the process runs before it exits.
+ * @param chain the chain.
+ * @return a bool denoting whether nothing follows the chain.
+ */
+bool isFinal(Chain *chain){
+    return lastInProcess && chain->onSuccess == NULL && chain->onFailure == NULL &&
+           (chain->next == NULL || chain->op == OP_BACKGROUND);
+}
+
+/**
+ * Runs the compound command of chain \param chain, for timeInShell.
+ * @param chain the chain.
+ */
+void callGroup(Chain *chain){
+    runCompound(chain->commands, isFinal(chain));
+}
+
+/**
+ * Runs chain \param chain, which consists of a single compound command. Groups,
+ * conditionals and loops run in the shell itself, with their redirections applied to the
+ * shell meanwhile. So does a subshell that cannot change the shell, or that is the last
+ * thing that a forked process does before it exits anyway; only other subshells are run
+ * by a forked copy of the shell.
+ * @param chain the chain.
+ */
+void runGroup(Chain *chain){
+    Command *cmd = chain->commands;
+    int saved[STANDARD_FDS];
+
+    if (cmd->compound->type == COMPOUND_SUBSHELL && !isFinal(chain) && changesShell(cmd->compound->body)){
+        runCommand(chain, false);
+        return;
+    }
+    if (redirectShell(cmd, saved)){
+        timeInShell(chain, callGroup);
+        restoreRedirections(saved);
+    }
+}
+
+/**
+ * Replaces the shell with program \param path. Output that the shell has buffered is
+ * written first, and input that it has read ahead is handed back, so that the program
+ * continues where the shell stopped reading. When that fails, the path is forgotten.
+ * @param path the resolved path of the program.
+ * @param argv the argument list of the program.
+ */
+void replaceShell(char *path, char **argv){
+    fflush(stdout);
+    fflush(stderr);
+    syncInput();
+    shellEnvironment();
+    executePath(path, argv, environ);
+    forgetCommand(argv[0]);     // the cached executable is gone
+}
+
+/**
+ * Runs chain \param chain, which consists of a single executable and is the last thing
+ * that the process does, by executing the program in the process itself instead of in a
+ * child that the process would only wait for. The redirections and assignments of the
+ * command are applied to the shell, which the program then replaces.
+ * @param chain the chain.
+ */
+void execFinal(Chain *chain){
+    Command *cmd = chain->commands;
+    char *path = lookupCommand(cmd->argv[0]);
+    int saved[STANDARD_FDS];
+
+    if (path == NULL){  // reported as usual
+        runCommand(chain, false);
+        return;
+    }
+    if (redirectShell(cmd, saved)){
+        applyAssignments(cmd, true);
+        replaceShell(path, cmd->argv);
+        restoreRedirections(saved);
+        printf("Error: command not found!\n");
+        last = 127;
+    }
+    setLastStatuses(1);
+    lastStatuses[0] = last;
+}
+
+/**
+ * Checks whether a command of chain \param chain has no words left after expansion.
+ * @param chain the chain.
+ * @return a bool denoting whether there is nothing to execute for some command.
+ */
+bool emptyCommand(Chain *chain){
+    for (Command *cmd = chain->commands; cmd != NULL; cmd = cmd->next){
+        if (cmd->argc == 0 && cmd->numWords > 0){
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Runs chain \param chain: a single builtin is executed by the shell itself, anything
+ * else in child processes, and assignments without a command set shell variables. A
+ * single executable that is the last thing that the process does replaces it instead.
+ * Expansions are done first; a single command that expands to nothing is not executed.
+ * @param chain the chain.
+ * @param background whether the shell does not wait for the child processes.
+ */
+void runChain(Chain *chain, bool background){
+    Command *cmd = chain->commands;
+    Expansion ex;
+    bool expanded = expandChain(chain, &ex);
+
+    if (expanded && emptyCommand(chain)){
+        if (chain->numCommands > 1){
+            printf("Error: command not found!\n");
+            last = 127;
+        }
+        setLastStatuses(1);
+        lastStatuses[0] = last;
+    }else if (cmd->numWords == 0 && chain->numCommands == 1){ // only assignments
+        last = 0;   // unless a command substitution in them fails
+        applyAssignments(cmd, false);
+        setLastStatuses(1);
+        lastStatuses[0] = last;
+    }else if (sameRedirections(chain)){ //check if input and output files are the same
+        printf("Error: input and output files cannot be equal!\n");
+        last = 2;
+        setLastStatuses(1);
+        lastStatuses[0] = last;
+    }else if (cmd->compound != NULL && chain->numCommands == 1 && !background){
+        runGroup(chain);
+    }else if (cmd->builtIn != NULL && chain->numCommands == 1){
+        runBuiltIn(chain);
+    }else if (chain->numCommands == 1 && !background && isFinal(chain) && !chain->timed && !tracing()){
+        execFinal(chain);
+    }else if (chain->numCommands == 1){
+        runCommand(chain, background);
+    }else{
+        runPipeline(chain, background);
+    }
+
+    if (expanded){
+        restoreChain(chain, &ex);
+    }
+}
+
+/**
+ * Runs the and-or list that starts with chain \param first. After each chain, the exit
+ * code selects the successor that the parser linked to it, so the chains that are
+ * skipped are never visited.
+ * @param first the first chain.
+ */
+void runAndOrList(Chain *first){
+    for (Chain *chain = first; chain != NULL; chain = last == 0 ? chain->onSuccess : chain->onFailure){
+        runChain(chain, false);
+    }
+}
+
+/**
+ * Starts the chains \param first up to \param end in the background. A single pipeline
+ * is started directly; anything that needs the shell itself (several chains, or a
+ * builtin) runs in a forked copy of the shell. So do all jobs in zygote mode, because the
+ * job table can only wait for children of the shell.
+ * @param first the first chain.
+ * @param end the last chain.
+ */
+void runBackground(Chain *first, Chain *end){
+    if (first == end && first->commands->builtIn == NULL && launchMode != LAUNCH_ZYGOTE){
+        runChain(first, true);
+        return;
+    }
+
+    fflush(stdout);
+    syncInput();
+    pid_t pid = fork();
+    if (pid == -1){
+        printf("Error in fork\n");
+        return;
+    }
+    if (pid == 0){
+        lastInProcess = true;
+        runAndOrList(first);
+        exit(last);
+    }
+
+    pid_t *pids = malloc(sizeof(*pids));
+    assert(pids != NULL);
+    pids[0] = pid;
+    startJob(first, end, pids, 1);
+}
+
+/**
+ * Runs the chains from \param chain on. The chains are grouped into and-or lists, which
+ * end at ";", "&" or the end of the list; a list that ends with "&" runs in the
+ * background.
+ * @param chain the first chain.
+ */
+void runList(Chain *chain){
+    while (chain != NULL){
+        reapJobs();     // also between the commands of a loop, which may run for a long time
+        Chain *end = chain;
+        while ((end->op == OP_AND || end->op == OP_OR) && end->next != NULL){
+            end = end->next;
+        }
+
+        if (end->op == OP_BACKGROUND){
+            runBackground(chain, end);
+        }else{
+            runAndOrList(chain);
+        }
+        chain = end->next;
+    }
+}
+
+/**
+ * Runs the chains from \param first on as part of a compound command.
+ * @param first the first chain.
+ * @param final whether the process exits after them.
+ */
+void runBody(Chain *first, bool final){
+    bool saved = lastInProcess;
+
+    lastInProcess = final;
+    runList(first);
+    lastInProcess = saved;
+}
+
+/**
+ * Runs if \param compound: the list after the first condition that succeeds, or the
+ * else list when none does. The exit code is 0 when nothing runs.
+ * @param compound the if.
+ * @param final whether the process exits after it.
+ */
+void runIf(Compound *compound, bool final){
+    for (Compound *c = compound; c != NULL; c = c->elseIf){
+        runBody(c->condition, false);
+        if (last == 0){
+            runBody(c->body, final);
+            return;
+        }
+        if (c->elseBody != NULL){
+            runBody(c->elseBody, final);
+            return;
+        }
+    }
+    last = 0;
+}
+
+/**
+ * Runs while or until loop \param compound: its body runs as long as its condition
+ * succeeds, or fails for until. The exit code is that of the last run of the body, or 0
+ * when it did not run.
+ * @param compound the loop.
+ */
+void runWhile(Compound *compound){
+    int status = 0;
+
+    while (true){
+        runBody(compound->condition, false);
+        if ((last == 0) != (compound->type == COMPOUND_WHILE)){
+            break;
+        }
+        runBody(compound->body, false);
+        status = last;
+    }
+    last = status;
+}
+
+/**
+ * Runs for loop \param compound: its words are expanded once, and its body runs for each
+ * of the resulting fields with the variable set to it. The exit code is that of the last
+ * run of the body, or 0 when it did not run.
+ * @param compound the loop.
+ */
+void runFor(Compound *compound){
+    Expansion ex;
+    char **fields = compound->words;
+    int numFields = compound->numWords;
+
+    if (compound->expand != NULL){
+        fields = expandList(compound->words, compound->numWords, compound->expand, &ex, &numFields);
+    }
+
+    size_t nameLength = strlen(compound->variable);
+    size_t size = 0;
+    char *entry = NULL;     // "NAME=value"
+    last = 0;
+    for (int i = 0; i < numFields; i++){
+        size_t n = nameLength + 1 + strlen(fields[i]) + 1;
+        if (n > size){
+            size = 2 * n;
+            entry = realloc(entry, size);
+            assert(entry != NULL);
+        }
+        memcpy(entry, compound->variable, nameLength);
+        entry[nameLength] = '=';
+        strcpy(entry + nameLength + 1, fields[i]);
+        setVariable(entry, false);
+
+        runBody(compound->body, false);
+    }
+    free(entry);
+
+    if (compound->expand != NULL){
+        freeExpansion(&ex);
+    }
+}
+
+/**
+ * Runs compound command \param cmd in the current process.
+ * @param cmd the command.
+ * @param final whether the process exits after it.
+ */
+void runCompound(Command *cmd, bool final){
+    Compound *compound = cmd->compound;
+
+    if (compound->type == COMPOUND_IF){
+        runIf(compound, final);
+    }else if (compound->type == COMPOUND_WHILE || compound->type == COMPOUND_UNTIL){
+        runWhile(compound);
+    }else if (compound->type == COMPOUND_FOR){
+        runFor(compound);
+    }else{
+        runBody(compound->body, final);
+    }
+}
+
+/**
+ * Executes the parse tree of an inputline.
+ * @param line the parse tree.
+ */
+void runInputLine(InputLine *line){
+    runList(line->chains);
+}
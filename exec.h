@@ -0,0 +1,54 @@
+#ifndef SHELL_EXEC_H
+#define SHELL_EXEC_H
+
+#include "shell.h"
+#include "trace.h"
+
+// the shell keeps its own stdin, stdout and stderr at or above this descriptor while a
+// builtin runs with redirections
+#define SAVED_FD_MIN 10
+
+// stdin, stdout and stderr: the descriptors that redirections apply to
+#define STANDARD_FDS 3
+
+// the descriptors that a child gets as stdin, stdout and stderr, after the redirections of
+// its command have been applied
+typedef struct ChildFds {
+    int fds[STANDARD_FDS];
+    int opened[2 * STANDARD_FDS];   // the descriptors that were opened for the child
+    int numOpened;
+} ChildFds;
+
+typedef enum LaunchMode {
+    LAUNCH_FORK,    // fork + execvp
+    LAUNCH_SPAWN,   // posix_spawn (clone with CLONE_VM | CLONE_VFORK in glibc)
+    LAUNCH_ZYGOTE   // a helper process that was forked at startup
+} LaunchMode;
+
+// the exit code of the last command executed
+extern int last;
+
+extern LaunchMode launchMode;
+
+// the exit codes of the parts of the most recent command, shown by "status -a"
+extern int *lastStatuses;
+extern int numLastStatuses;
+
+// whether the process exits once the list that it runs is done
+extern bool lastInProcess;
+
+void initExecutor();
+
+void setLastStatuses(int n);
+
+pid_t launchCommand(Command *cmd, int inFd, int outFd, CommandTiming *timing);
+
+int waitCommand(pid_t pid, Command *cmd, CommandTiming *timing);
+
+void replaceShell(char *path, char **argv);
+
+void runChain(Chain *chain, bool background);
+
+void runInputLine(InputLine *line);
+
+#endif
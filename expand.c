@@ -0,0 +1,668 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <sys/mman.h>
+
+#include "scanner.h"
+#include "shell.h"
+#include "exec.h"
+#include "expand.h"
+#include "variables.h"
+#include "wildcard.h"
+
+/**
+ * Makes room for \param n more characters in the buffer of expansion \param ex. The buffer
+ * doubles in size, so reading output of any length takes amortised constant time per
+ * character.
+ * @param ex the expansion.
+ * @param n the number of characters.
+ */
+void reserveExpansion(Expansion *ex, size_t n) {
+    if (ex->length + n <= ex->size) {
+        return;
+    }
+    while (ex->length + n > ex->size) {
+        ex->size = ex->size == 0 ? INITIAL_EXPANSION_SIZE : 2 * ex->size;
+    }
+    ex->buf = realloc(ex->buf, ex->size);
+    assert(ex->buf != NULL);
+}
+
+/**
+ * Appends character \param c to the buffer of expansion \param ex.
+ * @param ex the expansion.
+ * @param c the character.
+ */
+void putExpansion(Expansion *ex, char c) {
+    reserveExpansion(ex, 1);
+    ex->buf[ex->length++] = c;
+}
+
+/**
+ * Records that a word of expansion \param ex starts at offset \param start of its buffer.
+ * @param ex the expansion.
+ * @param start the offset of the word, which is NUL-terminated already.
+ */
+void addField(Expansion *ex, size_t start) {
+    if (ex->numFields == ex->fieldsSize) {
+        ex->fieldsSize = ex->fieldsSize == 0 ? INITIAL_FIELDS_SIZE : 2 * ex->fieldsSize;
+        ex->fields = realloc(ex->fields, ex->fieldsSize * sizeof(*ex->fields));
+        assert(ex->fields != NULL);
+    }
+    ex->fields[ex->numFields++] = start;
+}
+
+/**
+ * Appends everything that can be read from file descriptor \param fd to the buffer of
+ * expansion \param ex, until EOF.
+ * @param ex the expansion.
+ * @param fd the file descriptor.
+ */
+void readOutput(Expansion *ex, int fd) {
+    while (true) {
+        reserveExpansion(ex, INITIAL_EXPANSION_SIZE / 2);
+        ssize_t n = read(fd, ex->buf + ex->length, ex->size - ex->length);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            return;
+        }
+        ex->length += n;
+    }
+}
+
+/**
+ * Runs utility builtin \param chain in the shell itself, with stdout redirected to a
+ * memory file, and appends its output to expansion \param ex. This needs no child process
+ * at all, and a memory file, unlike a pipe, never blocks the builtin however much it
+ * writes.
+ * @param chain the chain, which consists of a utility builtin.
+ * @param ex the expansion.
+ */
+void captureBuiltIn(Chain *chain, Expansion *ex) {
+    int fd = memfd_create("substitution", MFD_CLOEXEC);
+    if (fd == -1) {
+        printf("Error in memfd_create\n");
+        return;
+    }
+
+    fflush(stdout);
+    int saved = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, SAVED_FD_MIN);
+    dup2(fd, STDOUT_FILENO);
+    runChain(chain, false);
+    fflush(stdout);
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+
+    off_t size = lseek(fd, 0, SEEK_CUR);
+    if (size > 0) {
+        reserveExpansion(ex, size);
+        ssize_t n = pread(fd, ex->buf + ex->length, size, 0);
+        ex->length += n > 0 ? n : 0;
+    }
+    close(fd);
+}
+
+/**
+ * Starts the single executable of chain \param chain with stdout connected to a pipe, and
+ * appends its output to expansion \param ex while it runs. The executable is started
+ * directly, in the selected launch mode, without a copy of the shell in between.
+ * @param chain the chain, which consists of a single executable.
+ * @param ex the expansion.
+ */
+void captureCommand(Chain *chain, Expansion *ex) {
+    int pipefd[2];
+    Expansion inner;
+
+    if (pipe2(pipefd, O_CLOEXEC) == -1) {
+        printf("Error in pipe\n");
+        return;
+    }
+    bool expanded = expandChain(chain, &inner);
+    Command *cmd = chain->commands;
+
+    pid_t pid = cmd->argc > 0 ? launchCommand(cmd, -1, pipefd[1], NULL) : -1;
+    close(pipefd[1]);
+    readOutput(ex, pipefd[0]);
+    close(pipefd[0]);
+    if (pid != -1) {
+        last = waitCommand(pid, cmd, NULL);
+    }
+
+    if (expanded) {
+        restoreChain(chain, &inner);
+    }
+}
+
+/**
+ * Runs inputline \param line in a forked copy of the shell with stdout connected to a
+ * pipe, and appends its output to expansion \param ex while it runs.
+ * @param line the inputline.
+ * @param ex the expansion.
+ */
+void captureSubshell(InputLine *line, Expansion *ex) {
+    int pipefd[2];
+
+    if (pipe2(pipefd, O_CLOEXEC) == -1) {
+        printf("Error in pipe\n");
+        return;
+    }
+    syncInput();
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == -1) {
+        printf("Error in fork\n");
+        close(pipefd[0]);
+        close(pipefd[1]);
+        return;
+    }
+    if (pid == 0) {
+        dup2(pipefd[1], STDOUT_FILENO);
+        lastInProcess = true;
+        runInputLine(line);
+        exit(last);
+    }
+
+    close(pipefd[1]);
+    readOutput(ex, pipefd[0]);
+    close(pipefd[0]);
+
+    int status;
+    while (waitpid(pid, &status, 0) == -1) {
+        if (errno != EINTR) {
+            return;
+        }
+    }
+    last = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+/**
+ * Executes the command substitution with text \param text and appends its output to the
+ * buffer of expansion \param ex. A single utility builtin runs in the shell itself and a
+ * single executable is started directly; anything else runs in a forked copy of the
+ * shell, so that it cannot change the shell.
+ * @param text the commands between "$(" and ")".
+ * @param length the length of \param text.
+ * @param ex the expansion.
+ */
+void captureOutput(char *text, size_t length, Expansion *ex) {
+    Arena arena = {NULL};
+    List tokenList = getTokenList(arenaStrndup(&arena, text, length), &arena);
+    InputLine line;
+
+    if (!parseInputLine(&tokenList, &line, &arena) || tokenList != NULL) {
+        printf("Error: invalid syntax!\n");
+        last = 2;
+        arenaFree(&arena);
+        return;
+    }
+
+    Chain *chain = line.chains;
+    if (chain == NULL) {
+        last = 0;
+    } else if (chain->next != NULL || chain->numCommands > 1 || chain->timed ||
+               chain->commands->redirections != NULL) {
+        captureSubshell(&line, ex);
+    } else if (chain->commands->builtIn == NULL) {
+        captureCommand(chain, ex);
+    } else if (chain->commands->builtIn->utility) {
+        captureBuiltIn(chain, ex);
+    } else {
+        captureSubshell(&line, ex);
+    }
+    arenaFree(&arena);
+}
+
+/**
+ * Puts a backslash before every backslash, and before every wildcard if \param wildcards
+ * holds, of the text at the end of the buffer of expansion \param ex from offset
+ * \param from, so that these characters only match themselves when the word is globbed.
+ * @param ex the expansion.
+ * @param from the offset of the text.
+ * @param wildcards whether wildcards are escaped as well.
+ */
+void escapeOutput(Expansion *ex, size_t from, bool wildcards) {
+    size_t n = 0;
+    for (size_t i = from; i < ex->length; i++) {
+        if (ex->buf[i] == '\\' || (wildcards && isWildcard(ex->buf[i]))) {
+            n++;
+        }
+    }
+    if (n == 0) {
+        return;
+    }
+
+    reserveExpansion(ex, n);
+    size_t out = ex->length + n;
+    for (size_t i = ex->length; i > from; i--) {   // from the end, so nothing is overwritten
+        char c = ex->buf[i - 1];
+        ex->buf[--out] = c;
+        if (c == '\\' || (wildcards && isWildcard(c))) {
+            ex->buf[--out] = '\\';
+        }
+    }
+    ex->length += n;
+}
+
+/**
+ * Appends path \param path as a word to the expansion \param arg, for matchWildcards.
+ * @param path the path.
+ * @param arg the expansion.
+ */
+void appendMatch(char *path, void *arg) {
+    Expansion *ex = arg;
+    size_t n = strlen(path) + 1;
+
+    reserveExpansion(ex, n);
+    memcpy(ex->buf + ex->length, path, n);
+    addField(ex, ex->length);
+    ex->length += n;
+}
+
+/**
+ * Records the word that occupies the buffer of expansion \param ex from offset
+ * \param start up to its NUL at offset \param end. If \param glob holds, the word is
+ * escaped as escapeOutput does: a word with an unescaped wildcard is replaced by the
+ * paths that match it, in sorted order, or stays as it is when nothing matches, and the
+ * escapes are removed. Any text after the word is moved behind the paths.
+ * @param ex the expansion.
+ * @param start the offset of the word.
+ * @param end the offset of its NUL.
+ * @param glob whether the word is globbed.
+ * @return the offset in the buffer right after the recorded words.
+ */
+size_t closeField(Expansion *ex, size_t start, size_t end, bool glob) {
+    char *word = ex->buf + start;
+
+    if (!glob || !isPattern(word, end - start)) {
+        if (glob && memchr(word, '\\', end - start) != NULL) {
+            unescapeWord(word);
+        }
+        addField(ex, start);
+        return end + 1;
+    }
+
+    char *pattern = strdup(word);
+    size_t restLength = ex->length - end - 1;
+    char *rest = malloc(restLength + 1);
+    assert(pattern != NULL && rest != NULL);
+    memcpy(rest, ex->buf + end + 1, restLength);
+
+    ex->length = start;
+    if (matchWildcards(pattern, &ex->dirs, appendMatch, ex) == 0) {
+        unescapeWord(pattern);
+        appendMatch(pattern, ex);
+    }
+    size_t next = ex->length;
+    reserveExpansion(ex, restLength);
+    memcpy(ex->buf + ex->length, rest, restLength);
+    ex->length += restLength;
+
+    free(pattern);
+    free(rest);
+    return next;
+}
+
+/**
+ * Splits the text of an unquoted expansion, which occupies the buffer of expansion
+ * \param ex from offset \param from, into words at whitespace, and globs them. The words
+ * are not copied: the first whitespace character after a word is replaced by its NUL.
+ * @param ex the expansion.
+ * @param from the offset of the output.
+ * @param open whether a word is being built; updated.
+ * @param start the offset of the word that is being built; updated.
+ */
+void splitOutput(Expansion *ex, size_t from, bool *open, size_t *start) {
+    for (size_t i = from; i < ex->length; i++) {
+        if (isspace((unsigned char)ex->buf[i])) {
+            if (*open) {
+                ex->buf[i] = '\0';
+                i = closeField(ex, *start, i, true) - 1;
+                *open = false;
+            }
+        } else if (!*open) {
+            *open = true;
+            *start = i;
+        }
+    }
+}
+
+/**
+ * Appends string \param value to the buffer of expansion \param ex.
+ * @param ex the expansion.
+ * @param value the string, or NULL for nothing.
+ */
+void putValue(Expansion *ex, char *value) {
+    if (value != NULL) {
+        size_t valueLength = strlen(value);
+        reserveExpansion(ex, valueLength);
+        memcpy(ex->buf + ex->length, value, valueLength);
+        ex->length += valueLength;
+    }
+}
+
+/**
+ * Appends the value of the parameter at the start of string \param s, which starts with
+ * "$" and satisfies isExpansion, to the buffer of expansion \param ex: "$?" is the exit
+ * code of the last command, "$#" the number of arguments, "$0" to "$9" and "${N}" the
+ * positional parameters, "$@" and "$*" the arguments separated by spaces, "$NAME" and
+ * "${NAME}" the value of a variable, or nothing when it is not set. A malformed "${" is
+ * taken literally.
+ * @param s the string.
+ * @param ex the expansion.
+ * @return the number of characters of \param s that were expanded.
+ */
+size_t expandParameter(char *s, Expansion *ex) {
+    char *name = s + 1;
+    size_t n, length;
+
+    if (s[1] == '?' || s[1] == '#') {
+        reserveExpansion(ex, 3 * sizeof(int) + 1);
+        ex->length += sprintf(ex->buf + ex->length, "%d", s[1] == '?' ? last : numArguments());
+        return 2;
+    }
+    if (s[1] == '@' || s[1] == '*') {
+        for (int i = 1; i <= numArguments(); i++) {
+            if (i > 1) {
+                putExpansion(ex, ' ');
+            }
+            putValue(ex, getPositional(i));
+        }
+        return 2;
+    }
+    if (isdigit((unsigned char)s[1])) {
+        putValue(ex, getPositional(s[1] - '0'));
+        return 2;
+    }
+    if (s[1] == '{' && isdigit((unsigned char)s[2])) {
+        int i = 0;
+        n = 2;
+        while (isdigit((unsigned char)s[n])) {
+            i = i > numArguments() ? i : 10 * i + s[n] - '0';   // any larger number is unset
+            n++;
+        }
+        if (s[n] != '}') {
+            putExpansion(ex, '$');
+            return 1;
+        }
+        putValue(ex, getPositional(i));
+        return n + 1;
+    }
+    if (s[1] == '{') {
+        name = s + 2;
+        n = variableNameLength(name);
+        if (n == 0 || name[n] != '}') {
+            putExpansion(ex, '$');
+            return 1;
+        }
+        length = n + 3;
+    } else {
+        n = variableNameLength(name);
+        length = n + 1;
+    }
+
+    putValue(ex, getVariable(name, n));
+    return length;
+}
+
+/**
+ * Expands word \param word, as the scanner kept it, into zero or more words at the end of
+ * the buffer of expansion \param ex, in a single pass. Quotes are removed, parameters
+ * are replaced by their values and command substitutions by their output without
+ * trailing newlines. If \param split holds, unquoted expansions are split into words at
+ * whitespace and words with unquoted wildcards are replaced by the paths they match.
+ * The word "$@" becomes the arguments, each a word of its own; elsewhere "$@" is "$*".
+ * @param word the word.
+ * @param ex the expansion.
+ * @param split whether words are split and globbed.
+ */
+void expandWord(char *word, Expansion *ex, bool split) {
+    bool quoted = false;
+    bool open = false;      // whether a word is being built
+    size_t start = 0;       // where that word starts in the buffer
+
+    if (split && strcmp(word, "\"$@\"") == 0) {
+        for (int i = 1; i <= numArguments(); i++) {
+            start = ex->length;
+            putValue(ex, getPositional(i));
+            putExpansion(ex, '\0');
+            addField(ex, start);
+        }
+        return;
+    }
+
+    for (size_t i = 0; word[i] != '\0'; ) {
+        size_t from = ex->length;
+
+        if (word[i] == '$' && word[i + 1] == '(') {
+            size_t n = substitutionLength(word + i);
+            captureOutput(word + i + 2, n - 2 - (word[i + n - 1] == ')'), ex);
+            while (ex->length > from && ex->buf[ex->length - 1] == '\n') {
+                ex->length--;
+            }
+            i += n;
+        } else if (isExpansion(word + i)) {
+            i += expandParameter(word + i, ex);
+        } else {
+            if (!open) {    // also for "": an empty quoted string is a word of its own
+                open = true;
+                start = ex->length;
+            }
+            if (word[i] == '\"') {
+                quoted = !quoted;
+            } else {
+                if (split && (word[i] == '\\' || (quoted && isWildcard(word[i])))) {
+                    putExpansion(ex, '\\');
+                }
+                putExpansion(ex, word[i]);
+            }
+            i++;
+            continue;
+        }
+
+        // the expanded text is at the end of the buffer, from offset from
+        if (split) {
+            escapeOutput(ex, from, quoted);
+        }
+        if ((quoted || !split) && !open) {
+            open = true;
+            start = from;
+        } else if (!quoted && split) {
+            splitOutput(ex, from, &open, &start);
+        }
+    }
+
+    if (open) {
+        putExpansion(ex, '\0');
+        closeField(ex, start, ex->length - 1, split);
+    }
+}
+
+/**
+ * Expands word \param word into a single string, such as the file name of a redirection:
+ * the output of command substitutions is not split.
+ * @param word the word, as the scanner kept it.
+ * @return the expanded word; the caller has to free it.
+ */
+char *expandText(char *word) {
+    Expansion ex;
+
+    memset(&ex, 0, sizeof(ex));
+    expandWord(word, &ex, false);
+    putExpansion(&ex, '\0');  // for a word that expands to nothing
+    free(ex.fields);
+    return ex.buf;
+}
+
+/**
+ * Expands the body of a here-document, \param body of \param length characters:
+ * parameters and command substitutions are replaced as in a quoted word, but quotes are
+ * kept. A backslash only escapes "$" and "\", and it removes the newline after it.
+ * @param body the body, followed by a NUL.
+ * @param length the length of the body; set to the length of the expanded body.
+ * @return the expanded body; the caller has to free it.
+ */
+char *expandBody(char *body, size_t *length) {
+    Expansion ex;
+
+    memset(&ex, 0, sizeof(ex));
+    for (size_t i = 0; i < *length; ) {
+        size_t from = ex.length;
+
+        if (body[i] == '\\' && (body[i + 1] == '$' || body[i + 1] == '\\')) {
+            putExpansion(&ex, body[i + 1]);
+            i += 2;
+        } else if (body[i] == '\\' && body[i + 1] == '\n') {
+            i += 2;
+        } else if (body[i] == '$' && body[i + 1] == '(') {
+            size_t n = substitutionLength(body + i);
+            captureOutput(body + i + 2, n - 2 - (body[i + n - 1] == ')'), &ex);
+            while (ex.length > from && ex.buf[ex.length - 1] == '\n') {
+                ex.length--;
+            }
+            i += n;
+        } else if (isExpansion(body + i)) {
+            i += expandParameter(body + i, &ex);
+        } else {
+            putExpansion(&ex, body[i++]);
+        }
+    }
+    putExpansion(&ex, '\0');   // for a body that expands to nothing
+    free(ex.fields);
+    *length = ex.length - 1;
+    return ex.buf;
+}
+
+/**
+ * Expands the \param numWords words \param words into fields at the end of the buffer of
+ * expansion \param ex. The words that \param expand marks are expanded, split and
+ * globbed; the others are copied as they are.
+ * @param words the words, as parsed.
+ * @param numWords the number of words.
+ * @param expand which words contain expansions.
+ * @param ex the expansion.
+ */
+void expandWords(char **words, int numWords, bool *expand, Expansion *ex) {
+    for (int i = 0; i < numWords; i++) {
+        if (expand[i]) {
+            expandWord(words[i], ex, true);
+        } else {
+            size_t n = strlen(words[i]) + 1;
+            reserveExpansion(ex, n);
+            memcpy(ex->buf + ex->length, words[i], n);
+            addField(ex, ex->length);
+            ex->length += n;
+        }
+    }
+}
+
+/**
+ * Expands the \param numWords words \param words into a list of fields, such as the
+ * words that a for loop assigns.
+ * @param words the words, as parsed.
+ * @param numWords the number of words.
+ * @param expand which words contain expansions.
+ * @param ex where the expansion is stored; freeExpansion releases it.
+ * @param count set to the number of fields.
+ * @return the NULL-terminated list of fields.
+ */
+char **expandList(char **words, int numWords, bool *expand, Expansion *ex, int *count) {
+    memset(ex, 0, sizeof(*ex));
+    expandWords(words, numWords, expand, ex);
+
+    ex->argvs = malloc((ex->numFields + 1) * sizeof(*ex->argvs));
+    assert(ex->argvs != NULL);
+    for (int i = 0; i < ex->numFields; i++) {
+        ex->argvs[i] = ex->buf + ex->fields[i];
+    }
+    ex->argvs[ex->numFields] = NULL;
+    *count = ex->numFields;
+    return ex->argvs;
+}
+
+/**
+ * Expands the argument lists of chain \param chain: command substitutions and variables
+ * are replaced by their values, and words with wildcards by the paths they match. The
+ * argv of every command with expansions is replaced by its expansion until restoreChain
+ * puts back the words of the parse tree, so the tree itself can be executed again, as
+ * happens to the lines of a script. Commands without expansions keep their argv, and a
+ * chain without any is not touched at all.
+ * @param chain the chain.
+ * @param ex where the expansion is stored.
+ * @return a bool denoting whether anything was expanded, so that restoreChain has to be
+ * called.
+ */
+bool expandChain(Chain *chain, Expansion *ex) {
+    bool needed = false;
+    for (Command *cmd = chain->commands; cmd != NULL; cmd = cmd->next) {
+        needed = needed || cmd->expand != NULL;
+    }
+    if (!needed) {
+        return false;
+    }
+
+    memset(ex, 0, sizeof(*ex));
+    int *counts = malloc(chain->numCommands * sizeof(*counts));
+    assert(counts != NULL);
+    int k = 0;
+    for (Command *cmd = chain->commands; cmd != NULL; cmd = cmd->next, k++) {
+        int first = ex->numFields;
+        if (cmd->expand != NULL) {
+            expandWords(cmd->words, cmd->numWords, cmd->expand, ex);
+        }
+        counts[k] = ex->numFields - first;
+    }
+
+    // the buffer does not move any more, so the words can be pointed to
+    ex->argvs = malloc((ex->numFields + chain->numCommands) * sizeof(*ex->argvs));
+    assert(ex->argvs != NULL);
+    char **argv = ex->argvs;
+    int f = 0;
+    k = 0;
+    for (Command *cmd = chain->commands; cmd != NULL; cmd = cmd->next, k++) {
+        if (cmd->expand == NULL) continue;
+
+        cmd->argv = argv;
+        cmd->argc = counts[k];
+        for (int i = 0; i < counts[k]; i++) {
+            *argv++ = ex->buf + ex->fields[f++];
+        }
+        *argv++ = NULL;
+    }
+    free(counts);
+    return true;
+}
+
+/**
+ * Puts back the argument lists of the parse tree of chain \param chain after expandChain,
+ * and releases expansion \param ex.
+ * @param chain the chain.
+ * @param ex the expansion.
+ */
+void restoreChain(Chain *chain, Expansion *ex) {
+    for (Command *cmd = chain->commands; cmd != NULL; cmd = cmd->next) {
+        cmd->argv = cmd->words;
+        cmd->argc = cmd->numWords;
+    }
+    freeExpansion(ex);
+}
+
+/**
+ * Releases expansion \param ex.
+ * @param ex the expansion.
+ */
+void freeExpansion(Expansion *ex) {
+    free(ex->buf);
+    free(ex->fields);
+    free(ex->argvs);
+    freeDirectoryCache(&ex->dirs);
+}
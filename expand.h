@@ -0,0 +1,39 @@
+#ifndef SHELL_EXPAND_H
+#define SHELL_EXPAND_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "shell.h"
+#include "wildcard.h"
+
+#define INITIAL_EXPANSION_SIZE 4096
+#define INITIAL_FIELDS_SIZE 16
+
+// the expanded argument lists of the commands of a chain. All their characters are kept in
+// one buffer, which the output of command substitutions is read into directly and then
+// split in place
+typedef struct Expansion {
+    char *buf;
+    size_t length;
+    size_t size;
+    size_t *fields;     // the offsets of the words in buf
+    int numFields;
+    int fieldsSize;
+    char **argvs;       // the argument lists of the expanded commands, pointing into buf
+    DirectoryCache dirs;    // the directories that wildcards were matched in
+} Expansion;
+
+char *expandText(char *word);
+
+char *expandBody(char *body, size_t *length);
+
+char **expandList(char **words, int numWords, bool *expand, Expansion *ex, int *count);
+
+bool expandChain(Chain *chain, Expansion *ex);
+
+void restoreChain(Chain *chain, Expansion *ex);
+
+void freeExpansion(Expansion *ex);
+
+#endif
@@ -0,0 +1,18 @@
+#include <stddef.h>
+
+#include "hash.h"
+
+/**
+ * Computes the FNV-1a hash of the first \param len characters of \param s.
+ * @param s input string.
+ * @param len number of characters to hash.
+ * @return the hash value.
+ */
+unsigned long hashString(const char *s, size_t len) {
+    unsigned long h = 14695981039346656037UL;
+    for (size_t i = 0; i < len; i++) {
+        h ^= (unsigned char)s[i];
+        h *= 1099511628211UL;
+    }
+    return h;
+}
@@ -0,0 +1,8 @@
+#ifndef SHELL_HASH_H
+#define SHELL_HASH_H
+
+#include <stddef.h>
+
+unsigned long hashString(const char *s, size_t len);
+
+#endif
@@ -0,0 +1,297 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "history.h"
+
+/**
+ * Rounds length \param n up to a multiple of 4, the alignment of the records.
+ * @param n the length.
+ * @return the rounded length.
+ */
+uint64_t alignRecord(uint64_t n) {
+    return (n + 3) & ~(uint64_t)3;
+}
+
+/**
+ * Returns the 4-byte word at logical position \param pos of the ring of history \param h.
+ * @param h the history.
+ * @param pos the logical position, a multiple of 4.
+ * @return a pointer to the word.
+ */
+uint32_t *historyWord(History *h, uint64_t pos) {
+    return (uint32_t *)(h->data + pos % h->capacity);
+}
+
+/**
+ * Returns the oldest logical position of history \param h that has not been overwritten
+ * when the head is at \param head.
+ * @param h the history.
+ * @param head the head.
+ * @return the position.
+ */
+uint64_t historyLimit(History *h, uint64_t head) {
+    return head > h->capacity ? head - h->capacity : 0;
+}
+
+/**
+ * Steps from logical position \param pos, the end of a record, to the start of that record,
+ * skipping the gap that precedes a wrap of the ring. Nothing before \param limit is read.
+ * @param h the history.
+ * @param pos the position; updated.
+ * @param limit the oldest position that may be read.
+ * @return a bool denoting whether a complete record was found.
+ */
+bool recordBefore(History *h, uint64_t *pos, uint64_t limit) {
+    while (*pos > limit) {
+        uint32_t word = *historyWord(h, *pos - 4);
+        if (word & HISTORY_GAP) {
+            word &= ~HISTORY_GAP;
+            if (word == 0 || word > *pos - limit) {
+                return false;
+            }
+            *pos -= word;
+            continue;
+        }
+
+        uint64_t size = alignRecord(word) + 8;
+        if (size > *pos - limit || *historyWord(h, *pos - size) != word) {
+            return false;
+        }
+        *pos -= size;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * Maps the whole file of history \param h, which is open as h->fd. An empty file gets the
+ * size HISTORY_FILE_SIZE and a header first. A file that is not empty must have a valid
+ * header, so that a history file of another program is never overwritten.
+ * @param h the history.
+ * @return a bool denoting whether the file was mapped.
+ */
+bool mapHistoryFile(History *h) {
+    struct stat st;
+    HistoryHeader header;
+
+    flock(h->fd, LOCK_EX);  // another shell may be initialising the file as well
+    if (fstat(h->fd, &st) == -1) {
+        flock(h->fd, LOCK_UN);
+        return false;
+    }
+    if (st.st_size == 0) {
+        header.magic = HISTORY_MAGIC;
+        header.version = HISTORY_VERSION;
+        header.capacity = HISTORY_FILE_SIZE;
+        header.head = 0;
+        st.st_size = HISTORY_HEADER_SIZE + HISTORY_FILE_SIZE;   // the file stays sparse
+        if (ftruncate(h->fd, st.st_size) == -1 ||
+            pwrite(h->fd, &header, sizeof(header), 0) != sizeof(header)) {
+            flock(h->fd, LOCK_UN);
+            return false;
+        }
+    }
+    flock(h->fd, LOCK_UN);
+
+    if (pread(h->fd, &header, sizeof(header), 0) != sizeof(header) || header.magic != HISTORY_MAGIC ||
+        header.version != HISTORY_VERSION || header.capacity % 4 != 0 ||
+        header.capacity + HISTORY_HEADER_SIZE != (uint64_t)st.st_size) {
+        return false;
+    }
+
+    h->mapSize = st.st_size;
+    h->map = mmap(NULL, h->mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, h->fd, 0);
+    return h->map != MAP_FAILED;
+}
+
+/**
+ * Opens the history in file \param path, which is created when it does not exist. Only
+ * the header is read: the records are indexed when they are first needed. When the file
+ * cannot be used, the history is kept in memory for this shell only.
+ * @param h the history to initialise.
+ * @param path the file, or NULL for a history in memory.
+ * @return a bool denoting whether a history could be set up at all.
+ */
+bool openHistory(History *h, char *path) {
+    memset(h, 0, sizeof(*h));
+    h->fd = path == NULL ? -1 : open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+    if (h->fd != -1 && !mapHistoryFile(h)) {
+        close(h->fd);
+        h->fd = -1;
+    }
+    if (h->fd == -1) {
+        h->mapSize = HISTORY_HEADER_SIZE + HISTORY_MEMORY_SIZE;
+        h->map = mmap(NULL, h->mapSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (h->map == MAP_FAILED) {
+            h->map = NULL;
+            return false;
+        }
+        HistoryHeader *header = (HistoryHeader *)h->map;
+        header->magic = HISTORY_MAGIC;
+        header->version = HISTORY_VERSION;
+        header->capacity = HISTORY_MEMORY_SIZE;
+    }
+
+    h->header = (HistoryHeader *)h->map;
+    h->data = h->map + HISTORY_HEADER_SIZE;
+    h->capacity = h->header->capacity;
+    return true;
+}
+
+/**
+ * Appends line \param line to history \param h, unless it is the same as the newest
+ * entry. Shells that share the file append under an exclusive lock; the head is only
+ * advanced once the record is complete, so readers never see a partial record. When the
+ * record does not fit before the end of the ring, the rest of the ring is marked as a gap
+ * and the record is written at its start, overwriting the oldest entries.
+ * @param h the history.
+ * @param line the line.
+ * @param length the length of \param line.
+ */
+void addHistory(History *h, char *line, size_t length) {
+    uint64_t size = alignRecord(length) + 8;
+
+    if (h->map == NULL || length == 0 || size > h->capacity / 4) {
+        return;
+    }
+    if (h->fd != -1) {
+        flock(h->fd, LOCK_EX);
+    }
+
+    uint64_t head = __atomic_load_n(&h->header->head, __ATOMIC_ACQUIRE);
+    uint64_t start = head;
+    if (recordBefore(h, &start, historyLimit(h, head)) && *historyWord(h, start) == length &&
+        memcmp(h->data + start % h->capacity + 4, line, length) == 0) {
+        if (h->fd != -1) {
+            flock(h->fd, LOCK_UN);
+        }
+        return;
+    }
+
+    uint64_t offset = head % h->capacity;
+    if (offset + size > h->capacity) {
+        uint32_t gap = h->capacity - offset;
+        *historyWord(h, head + gap - 4) = HISTORY_GAP | gap;
+        head += gap;
+        offset = 0;
+    }
+    char *record = h->data + offset;
+    *historyWord(h, head) = length;
+    memcpy(record + 4, line, length);
+    memset(record + 4 + length, 0, alignRecord(length) - length);
+    *historyWord(h, head + size - 4) = length;
+    __atomic_store_n(&h->header->head, head + size, __ATOMIC_RELEASE);
+
+    if (h->fd != -1) {
+        flock(h->fd, LOCK_UN);
+    }
+}
+
+/**
+ * Brings the index of history \param h up to date with the records that were appended
+ * since the last call, by this shell or another one. Only the new records are visited,
+ * from the head backwards, so the whole history is read once at most.
+ * @param h the history.
+ * @return the number of entries.
+ */
+size_t updateHistoryIndex(History *h) {
+    if (h->map == NULL) {
+        return 0;
+    }
+    uint64_t head = __atomic_load_n(&h->header->head, __ATOMIC_ACQUIRE);
+    uint64_t limit = historyLimit(h, head);
+    uint64_t stop = h->indexed > limit ? h->indexed : limit;
+    size_t old = h->count;
+
+    uint64_t pos = head;
+    while (pos > stop && recordBefore(h, &pos, stop)) {
+        if (h->count == h->indexSize) {
+            h->indexSize = h->indexSize == 0 ? INITIAL_HISTORY_INDEX_SIZE : 2 * h->indexSize;
+            h->index = realloc(h->index, h->indexSize * sizeof(*h->index));
+            assert(h->index != NULL);
+        }
+        h->index[h->count++] = pos;
+    }
+    if (pos != h->indexed) {    // the new records do not connect to the indexed ones
+        memmove(h->index, h->index + old, (h->count - old) * sizeof(*h->index));
+        h->count -= old;
+        old = h->first = 0;
+    }
+    for (size_t i = old, j = h->count; i + 1 < j; i++, j--) {   // oldest first
+        uint64_t tmp = h->index[i];
+        h->index[i] = h->index[j - 1];
+        h->index[j - 1] = tmp;
+    }
+    h->indexed = head;
+
+    while (h->first < h->count && h->index[h->first] < limit) {
+        h->first++;
+    }
+    return h->count - h->first;
+}
+
+/**
+ * Returns entry \param i of history \param h, as the index was last updated.
+ * @param h the history.
+ * @param i the number of the entry; 0 is the oldest.
+ * @param length set to the length of the entry.
+ * @return the entry, which is not NUL-terminated and points into the mapping, or NULL
+ * when it has been overwritten since.
+ */
+char *historyEntry(History *h, size_t i, size_t *length) {
+    uint64_t pos = h->index[h->first + i];
+
+    if (pos < historyLimit(h, __atomic_load_n(&h->header->head, __ATOMIC_ACQUIRE))) {
+        return NULL;
+    }
+    *length = *historyWord(h, pos);
+    return h->data + pos % h->capacity + 4;
+}
+
+/**
+ * Finds the newest entry of history \param h, from entry \param from back, that contains
+ * \param query.
+ * @param h the history.
+ * @param query the text to search for.
+ * @param queryLength the length of \param query.
+ * @param from the number of the newest entry to consider.
+ * @return the number of the entry, or -1 when there is none.
+ */
+long searchHistory(History *h, char *query, size_t queryLength, long from) {
+    for (long i = from; i >= 0; i--) {
+        size_t length;
+        char *entry = historyEntry(h, i, &length);
+        if (entry == NULL) {
+            break;  // the older entries are overwritten as well
+        }
+        if (memmem(entry, length, query, queryLength) != NULL) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Releases history \param h.
+ * @param h the history.
+ */
+void closeHistory(History *h) {
+    if (h->map != NULL) {
+        munmap(h->map, h->mapSize);
+    }
+    if (h->fd != -1) {
+        close(h->fd);
+    }
+    free(h->index);
+    h->map = NULL;
+    h->index = NULL;
+}
@@ -0,0 +1,54 @@
+#ifndef SHELL_HISTORY_H
+#define SHELL_HISTORY_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISTORY_FILE_NAME ".shell_history"
+#define HISTORY_FILE_SIZE (32 << 20)    // room for about a million typical command lines
+#define HISTORY_MEMORY_SIZE (1 << 20)   // when there is no history file
+#define HISTORY_HEADER_SIZE 4096
+#define HISTORY_MAGIC 0x48495354        // "HIST"
+#define HISTORY_VERSION 1
+#define HISTORY_GAP 0x80000000u         // marks the unused end of the ring before a wrap
+#define INITIAL_HISTORY_INDEX_SIZE 1024
+
+// the start of the history file. The data area after it is a ring of records
+// [length][text][padding][length], aligned to 4 bytes; head counts every byte ever
+// appended, so the record before head can always be found from its trailing length
+typedef struct HistoryHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t capacity;      // the size of the data area
+    uint64_t head;          // the logical position where the next record is appended
+} HistoryHeader;
+
+// a mapped history, shared by every shell that uses the same file
+typedef struct History {
+    int fd;
+    char *map;
+    size_t mapSize;
+    HistoryHeader *header;
+    char *data;
+    uint64_t capacity;
+    uint64_t *index;        // the logical positions of the records, oldest first
+    size_t count;
+    size_t indexSize;
+    size_t first;           // the records before first have been overwritten
+    uint64_t indexed;       // the head up to which the index is complete
+} History;
+
+bool openHistory(History *h, char *path);
+
+void addHistory(History *h, char *line, size_t length);
+
+size_t updateHistoryIndex(History *h);
+
+char *historyEntry(History *h, size_t i, size_t *length);
+
+long searchHistory(History *h, char *query, size_t queryLength, long from);
+
+void closeHistory(History *h);
+
+#endif
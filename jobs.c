@@ -0,0 +1,338 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "jobs.h"
+
+bool interactive = false;
+
+// the job table, ordered by job id
+Job **jobTable = NULL;
+int numJobs = 0;
+int jobTableSize = 0;
+
+// the running processes of the jobs, hashed by pid, so that a terminated child is found
+// without looking at every job. The number of buckets is a power of 2
+JobProcess **processTable = NULL;
+size_t numProcesses = 0;
+size_t processTableSize = 0;
+
+// set by the SIGCHLD handler; the children are reaped outside of the handler
+volatile sig_atomic_t childExited = 0;
+
+/**
+ * Handler for SIGCHLD. It only records that some child has terminated, so that the next
+ * call of reapJobs knows that there may be something to reap.
+ * @param sig the signal number.
+ */
+void handleSigChld(int sig) {
+    childExited = 1;
+}
+
+/**
+ * Installs the SIGCHLD handler. System calls that are interrupted by it are restarted,
+ * so a terminating background job never disturbs reading input or waiting for a child.
+ */
+void initJobs() {
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = handleSigChld;
+    sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, NULL);
+}
+
+/**
+ * Returns the bucket of process table that holds process \param pid.
+ * @param pid the process.
+ * @return the bucket.
+ */
+JobProcess **processBucket(pid_t pid) {
+    return &processTable[(size_t)pid & (processTableSize - 1)];
+}
+
+/**
+ * Adds process \param pid, number \param index of job \param job, to the process table.
+ * The table doubles when it holds as many processes as it has buckets.
+ * @param pid the process.
+ * @param job the job.
+ * @param index the position of the process in the pids of the job.
+ */
+void addProcess(pid_t pid, Job *job, int index) {
+    if (numProcesses == processTableSize) {
+        size_t oldSize = processTableSize;
+        JobProcess **old = processTable;
+
+        processTableSize = oldSize == 0 ? INITIAL_PROCESS_TABLE_SIZE : 2 * oldSize;
+        processTable = calloc(processTableSize, sizeof(*processTable));
+        assert(processTable != NULL);
+        for (size_t i = 0; i < oldSize; i++) {
+            while (old[i] != NULL) {
+                JobProcess *p = old[i];
+                old[i] = p->next;
+                p->next = *processBucket(p->pid);
+                *processBucket(p->pid) = p;
+            }
+        }
+        free(old);
+    }
+
+    JobProcess *p = malloc(sizeof(*p));
+    assert(p != NULL);
+    p->pid = pid;
+    p->job = job;
+    p->index = index;
+    p->next = *processBucket(pid);
+    *processBucket(pid) = p;
+    numProcesses++;
+}
+
+/**
+ * Removes process \param pid from the process table and marks it as terminated in its
+ * job. The job is done when it was its last running process.
+ * @param pid the process.
+ * @param index where the position of the process in its job is stored.
+ * @return the job of the process, or NULL when it does not belong to a job.
+ */
+Job *endProcess(pid_t pid, int *index) {
+    if (numProcesses == 0) {
+        return NULL;
+    }
+    for (JobProcess **pp = processBucket(pid); *pp != NULL; pp = &(*pp)->next) {
+        JobProcess *p = *pp;
+        if (p->pid != pid) {
+            continue;
+        }
+        Job *job = p->job;
+        *index = p->index;
+        *pp = p->next;
+        free(p);
+        numProcesses--;
+
+        job->pids[*index] = -1;
+        if (--job->numRunning == 0) {
+            job->state = JOB_DONE;
+        }
+        return job;
+    }
+    return NULL;
+}
+
+/**
+ * Adds a job to the job table. The job takes ownership of \param pids and \param command.
+ * A shell that is not interactive keeps no finished jobs but the most recent one, whose
+ * exit code wait still reports, so its table only grows with the jobs that are running.
+ * @param pids the processes of the job.
+ * @param numPids number of processes.
+ * @param command the command as it is shown by the jobs builtin.
+ * @return the new job.
+ */
+Job *addJob(pid_t *pids, int numPids, char *command) {
+    if (!interactive && numJobs > 0 && jobTable[numJobs - 1]->state == JOB_DONE) {
+        removeJob(jobTable[numJobs - 1]);
+    }
+    if (numJobs == jobTableSize) {
+        jobTableSize = jobTableSize == 0 ? INITIAL_JOB_TABLE_SIZE : 2 * jobTableSize;
+        jobTable = realloc(jobTable, jobTableSize * sizeof(*jobTable));
+        assert(jobTable != NULL);
+    }
+
+    Job *job = malloc(sizeof(*job));
+    assert(job != NULL);
+    job->id = numJobs == 0 ? 1 : jobTable[numJobs - 1]->id + 1;
+    job->pids = pids;
+    job->numPids = job->numRunning = numPids;
+    job->status = 0;
+    job->state = numPids == 0 ? JOB_DONE : JOB_RUNNING;
+    job->command = command;
+    jobTable[numJobs++] = job;
+    for (int i = 0; i < numPids; i++) {
+        addProcess(pids[i], job, i);
+    }
+
+    if (interactive) {
+        printf("[%d] %d\n", job->id, numPids == 0 ? 0 : (int)pids[numPids - 1]);
+    }
+    return job;
+}
+
+/**
+ * Records that process \param pid terminated with \param status, if it belongs to a job.
+ * @param pid the process that terminated.
+ * @param status the status reported by waitpid.
+ * @return the job of the process, or NULL when it does not belong to a job.
+ */
+Job *recordChildExit(pid_t pid, int status) {
+    int index;
+    Job *job = endProcess(pid, &index);
+
+    if (job != NULL && index == job->numPids - 1) { // the exit code of a job is that of its last process
+        job->status = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+    }
+    return job;
+}
+
+/**
+ * Reaps the processes of background jobs that have terminated, without blocking. Does
+ * nothing unless a SIGCHLD arrived since the last call. When the shell is not
+ * interactive, the jobs that finish are released right away, except the most recent one.
+ * Only called while the shell has no other children to wait for, so it may reap any child.
+ */
+void reapJobs() {
+    if (!childExited) {
+        return;
+    }
+    childExited = 0;
+
+    pid_t pid;
+    int status;
+    while (numProcesses > 0 && (pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        Job *job = recordChildExit(pid, status);
+        if (job != NULL && job->state == JOB_DONE && !interactive && job != jobTable[numJobs - 1]) {
+            removeJob(job);
+        }
+    }
+}
+
+/**
+ * Removes job \param job from the job table and releases it.
+ * @param job the job.
+ */
+void removeJob(Job *job) {
+    for (int i = 0; i < numJobs; i++) {
+        if (jobTable[i] == job) {
+            memmove(jobTable + i, jobTable + i + 1, (numJobs - i - 1) * sizeof(*jobTable));
+            numJobs--;
+            break;
+        }
+    }
+    int index;
+    for (int j = 0; j < job->numPids; j++) {
+        if (job->pids[j] != -1) {
+            endProcess(job->pids[j], &index);
+        }
+    }
+    free(job->pids);
+    free(job->command);
+    free(job);
+}
+
+/**
+ * Prints a line for job \param job in the format of the jobs builtin.
+ * @param job the job.
+ */
+void printJob(Job *job) {
+    if (job->state == JOB_RUNNING) {
+        printf("[%d]  Running\t\t%s &\n", job->id, job->command);
+    } else if (job->status == 0) {
+        printf("[%d]  Done\t\t\t%s\n", job->id, job->command);
+    } else {
+        printf("[%d]  Exit %d\t\t%s\n", job->id, job->status, job->command);
+    }
+}
+
+/**
+ * Reports the background jobs that have finished and removes them from the table. Only
+ * an interactive shell reports them; a script asks for them with jobs or wait.
+ */
+void notifyJobs() {
+    reapJobs();
+    if (!interactive) {
+        return;
+    }
+    for (int i = 0; i < numJobs; i++) {
+        if (jobTable[i]->state == JOB_DONE) {
+            printJob(jobTable[i]);
+            removeJob(jobTable[i--]);
+        }
+    }
+}
+
+/**
+ * Prints all jobs, and removes the jobs that have finished.
+ */
+void printJobs() {
+    reapJobs();
+    for (int i = 0; i < numJobs; i++) {
+        printJob(jobTable[i]);
+        if (jobTable[i]->state == JOB_DONE) {
+            removeJob(jobTable[i--]);
+        }
+    }
+}
+
+/**
+ * Finds a job by its job specification: "%n" for job number n, "%%" or "%+" for the most
+ * recent job, or the pid of one of its processes.
+ * @param spec the job specification, or NULL for the most recent job.
+ * @return the job, or NULL when there is no such job.
+ */
+Job *findJob(char *spec) {
+    if (numJobs == 0) {
+        return NULL;
+    }
+    if (spec == NULL || strcmp(spec, "%%") == 0 || strcmp(spec, "%+") == 0) {
+        return jobTable[numJobs - 1];
+    }
+
+    bool byId = spec[0] == '%';
+    char *end;
+    long n = strtol(byId ? spec + 1 : spec, &end, 10);
+    if (*end != '\0') {
+        return NULL;
+    }
+
+    for (int i = 0; i < numJobs; i++) {
+        if (byId && jobTable[i]->id == n) {
+            return jobTable[i];
+        }
+        for (int j = 0; !byId && j < jobTable[i]->numPids; j++) {
+            if (jobTable[i]->pids[j] == n) {
+                return jobTable[i];
+            }
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Waits until all processes of job \param job have terminated.
+ * @param job the job.
+ * @return the exit code of the job.
+ */
+int waitJob(Job *job) {
+    for (int j = 0; j < job->numPids; j++) {
+        int status;
+        pid_t pid = job->pids[j];
+        if (pid == -1) {
+            continue;
+        }
+        if (waitpid(pid, &status, 0) == pid) {
+            recordChildExit(pid, status);
+        } else if (errno == ECHILD) { // it was reaped elsewhere
+            int index;
+            endProcess(pid, &index);
+        }
+    }
+    return job->status;
+}
+
+/**
+ * Waits for all jobs and empties the job table.
+ * @return the exit code of the last job, or 0 when there were no jobs.
+ */
+int waitAllJobs() {
+    int status = 0;
+    while (numJobs > 0) {
+        status = waitJob(jobTable[0]);
+        removeJob(jobTable[0]);
+    }
+    return status;
+}
@@ -0,0 +1,57 @@
+#ifndef SHELL_JOBS_H
+#define SHELL_JOBS_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#define INITIAL_JOB_TABLE_SIZE 8
+#define INITIAL_PROCESS_TABLE_SIZE 16
+
+typedef enum JobState {
+    JOB_RUNNING,
+    JOB_DONE
+} JobState;
+
+// a chain (or list of chains) that runs in the background
+typedef struct Job {
+    int id;
+    pid_t *pids;        // the processes of the job
+    int numPids;
+    int numRunning;
+    int status;         // exit code of the last process of the job
+    JobState state;
+    char *command;      // the command as it is shown by the jobs builtin
+} Job;
+
+// a running process of a job, in the bucket of its pid in the process table
+typedef struct JobProcess {
+    pid_t pid;
+    Job *job;
+    int index;          // the position of the process in the pids of the job
+    struct JobProcess *next;
+} JobProcess;
+
+// whether the shell reads commands from a terminal
+extern bool interactive;
+
+void initJobs();
+
+Job *addJob(pid_t *pids, int numPids, char *command);
+
+Job *recordChildExit(pid_t pid, int status);
+
+void reapJobs();
+
+void notifyJobs();
+
+Job *findJob(char *spec);
+
+int waitJob(Job *job);
+
+int waitAllJobs();
+
+void removeJob(Job *job);
+
+void printJobs();
+
+#endif
@@ -0,0 +1,640 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+#include "scanner.h"
+#include "history.h"
+#include "lineedit.h"
+#include "relay.h"
+#include "variables.h"
+
+// the history that the editor recalls and searches; opened on first use
+History history;
+bool historyOpened = false;
+
+// the terminal settings outside of editLine
+struct termios savedTermios;
+
+EditBuffer screen = {NULL, 0, 0};   // what refreshLine writes to the terminal
+EditBuffer result = {NULL, 0, 0};   // the line that editLine returns
+
+/**
+ * Makes room for \param n more characters in buffer \param b.
+ * @param b the buffer.
+ * @param n the number of characters.
+ */
+void reserveEdit(EditBuffer *b, size_t n) {
+    if (b->length + n <= b->size) {
+        return;
+    }
+    while (b->length + n > b->size) {
+        b->size = b->size == 0 ? INITIAL_EDIT_SIZE : 2 * b->size;
+    }
+    b->text = realloc(b->text, b->size);
+    assert(b->text != NULL);
+}
+
+/**
+ * Inserts the \param n characters at \param s into buffer \param b at offset \param pos.
+ * @param b the buffer.
+ * @param pos the offset.
+ * @param s the characters.
+ * @param n the number of characters.
+ */
+void insertEdit(EditBuffer *b, size_t pos, char *s, size_t n) {
+    if (n == 0) {
+        return;
+    }
+    reserveEdit(b, n);
+    memmove(b->text + pos + n, b->text + pos, b->length - pos);
+    memcpy(b->text + pos, s, n);
+    b->length += n;
+}
+
+/**
+ * Appends the \param n characters at \param s to buffer \param b.
+ * @param b the buffer.
+ * @param s the characters.
+ * @param n the number of characters.
+ */
+void appendEdit(EditBuffer *b, char *s, size_t n) {
+    insertEdit(b, b->length, s, n);
+}
+
+/**
+ * Removes \param n characters from buffer \param b at offset \param pos.
+ * @param b the buffer.
+ * @param pos the offset.
+ * @param n the number of characters.
+ */
+void eraseEdit(EditBuffer *b, size_t pos, size_t n) {
+    memmove(b->text + pos, b->text + pos + n, b->length - pos - n);
+    b->length -= n;
+}
+
+/**
+ * Checks whether lines can be edited: both stdin and stderr, which the editor draws on,
+ * must be terminals.
+ * @return a bool denoting whether editLine can be used.
+ */
+bool canEditLines() {
+    return isatty(STDIN_FILENO) && isatty(STDERR_FILENO);
+}
+
+/**
+ * Opens the history file: $HISTFILE, or HISTORY_FILE_NAME in the home directory. Only
+ * its header is read, so this is cheap however long the history is.
+ */
+void openShellHistory() {
+    char *path = getVariable("HISTFILE", 8);
+    char *home = getVariable("HOME", 4);
+    char *allocated = NULL;
+
+    historyOpened = true;
+    if ((path == NULL || *path == '\0') && home != NULL) {
+        allocated = malloc(strlen(home) + strlen(HISTORY_FILE_NAME) + 2);
+        assert(allocated != NULL);
+        sprintf(allocated, "%s/%s", home, HISTORY_FILE_NAME);
+        path = allocated;
+    }
+    openHistory(&history, path != NULL && *path != '\0' ? path : NULL);
+    free(allocated);
+}
+
+/**
+ * Puts the terminal in raw mode: keys are read one by one, without echo, and Ctrl-C
+ * arrives as a key instead of a signal.
+ * @return a bool denoting whether the terminal could be put in raw mode.
+ */
+bool enableRawMode() {
+    struct termios raw;
+
+    if (tcgetattr(STDIN_FILENO, &savedTermios) == -1) {
+        return false;
+    }
+    raw = savedTermios;
+    raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_cflag |= CS8;
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    return tcsetattr(STDIN_FILENO, TCSADRAIN, &raw) == 0;
+}
+
+/**
+ * Restores the terminal settings that enableRawMode replaced.
+ */
+void disableRawMode() {
+    tcsetattr(STDIN_FILENO, TCSADRAIN, &savedTermios);
+}
+
+/**
+ * Determines the width of the terminal.
+ * @return the number of columns.
+ */
+size_t terminalColumns() {
+    struct winsize ws;
+
+    if (ioctl(STDERR_FILENO, TIOCGWINSZ, &ws) == -1 || ws.ws_col == 0) {
+        return DEFAULT_COLUMNS;
+    }
+    return ws.ws_col;
+}
+
+/**
+ * Reads a byte from the terminal.
+ * @return the byte, or -1 at EOF.
+ */
+int readByte() {
+    unsigned char c;
+    ssize_t n;
+
+    do {
+        n = read(STDIN_FILENO, &c, 1);
+    } while (n == -1 && errno == EINTR);
+    return n == 1 ? c : -1;
+}
+
+/**
+ * Reads a key from the terminal. The escape sequences of the cursor keys, Home, End and
+ * Delete, with or without Ctrl, are translated to the values of enum Key; other
+ * sequences are read completely and ignored.
+ * @return the key, or -1 at EOF.
+ */
+int readKey() {
+    int c = readByte();
+    if (c != '\x1b') {
+        return c;
+    }
+
+    c = readByte();
+    if (c == 'b' || c == 'f') { // Alt-b and Alt-f
+        return c == 'b' ? KEY_WORD_LEFT : KEY_WORD_RIGHT;
+    }
+    if (c != '[' && c != 'O') {
+        return c == -1 ? -1 : KEY_NONE;
+    }
+
+    int number = 0, modifier = 0;
+    bool semicolon = false;
+    while ((c = readByte()) != -1 && (isdigit(c) || c == ';')) {
+        if (c == ';') {
+            semicolon = true;
+        } else if (semicolon) {
+            modifier = 10 * modifier + c - '0';
+        } else {
+            number = 10 * number + c - '0';
+        }
+    }
+
+    bool ctrl = modifier == 5;
+    switch (c) {
+    case 'A':
+        return KEY_UP;
+    case 'B':
+        return KEY_DOWN;
+    case 'C':
+        return ctrl ? KEY_WORD_RIGHT : KEY_RIGHT;
+    case 'D':
+        return ctrl ? KEY_WORD_LEFT : KEY_LEFT;
+    case 'H':
+        return KEY_HOME;
+    case 'F':
+        return KEY_END;
+    case '~':
+        if (number == 1 || number == 7) {
+            return KEY_HOME;
+        }
+        if (number == 4 || number == 8) {
+            return KEY_END;
+        }
+        return number == 3 ? KEY_DELETE : KEY_NONE;
+    default:
+        return c == -1 ? -1 : KEY_NONE;
+    }
+}
+
+/**
+ * Redraws the current terminal line: prompt \param prompt followed by the text of
+ * \param line, with the cursor at offset \param cursor of it. A line that does not fit
+ * is scrolled horizontally so that the cursor stays visible. Everything is written at
+ * once, so the line does not flicker.
+ * @param prompt the prompt.
+ * @param line the text.
+ * @param cursor the offset of the cursor in \param line.
+ */
+void refreshLine(char *prompt, EditBuffer *line, size_t cursor) {
+    size_t promptLength = strlen(prompt);
+    size_t columns = terminalColumns();
+
+    if (columns < promptLength + 2) {
+        columns = promptLength + 2;
+    }
+    size_t start = 0;
+    if (promptLength + cursor + 1 > columns) {
+        start = promptLength + cursor + 1 - columns;
+    }
+    size_t length = line->length - start;
+    if (promptLength + length + 1 > columns) {
+        length = columns - promptLength - 1;
+    }
+
+    screen.length = 0;
+    appendEdit(&screen, "\r", 1);
+    appendEdit(&screen, prompt, promptLength);
+    for (size_t i = start; i < start + length; i++) {
+        char c = line->text[i];
+        appendEdit(&screen, iscntrl((unsigned char)c) ? "?" : &c, 1);
+    }
+    appendEdit(&screen, "\x1b[0K\r", 5);   // clear the rest of the line, back to column 0
+    char move[32];
+    if (promptLength + cursor > start) {
+        appendEdit(&screen, move, sprintf(move, "\x1b[%zuC", promptLength + cursor - start));
+    }
+    writeAll(STDERR_FILENO, screen.text, screen.length);
+}
+
+/**
+ * Replaces the text of the line of editor \param e by the \param n characters at
+ * \param s, with the cursor at the end.
+ * @param e the editor.
+ * @param s the characters.
+ * @param n the number of characters.
+ */
+void replaceLine(LineEditor *e, char *s, size_t n) {
+    e->line.length = 0;
+    appendEdit(&e->line, s, n);
+    e->cursor = n;
+}
+
+/**
+ * Shows the history entry before (\param direction -1) or after (1) the one that editor
+ * \param e shows. Going back from the new line keeps it as a draft, which is shown
+ * again after the newest entry.
+ * @param e the editor.
+ * @param direction -1 or 1.
+ */
+void moveInHistory(LineEditor *e, int direction) {
+    if (e->historyPos == -1) {
+        if (direction > 0) {
+            return;
+        }
+        e->historyCount = updateHistoryIndex(&history);
+        e->historyPos = e->historyCount;
+        e->draft.length = 0;
+        appendEdit(&e->draft, e->line.text, e->line.length);
+    }
+
+    long pos = e->historyPos + direction;
+    if (pos < 0) {
+        return;
+    }
+    if (pos >= (long)e->historyCount) {
+        replaceLine(e, e->draft.text, e->draft.length);
+        e->historyPos = -1;
+        return;
+    }
+    size_t length;
+    char *entry = historyEntry(&history, pos, &length);
+    if (entry != NULL) {    // not overwritten by another shell meanwhile
+        replaceLine(e, entry, length);
+        e->historyPos = pos;
+    }
+}
+
+/**
+ * Determines where the word before offset \param pos of the line of editor \param e
+ * starts.
+ * @param e the editor.
+ * @param pos the offset.
+ * @return the offset of the word.
+ */
+size_t wordBefore(LineEditor *e, size_t pos) {
+    while (pos > 0 && isspace((unsigned char)e->line.text[pos - 1])) {
+        pos--;
+    }
+    while (pos > 0 && !isspace((unsigned char)e->line.text[pos - 1])) {
+        pos--;
+    }
+    return pos;
+}
+
+/**
+ * Determines where the word after offset \param pos of the line of editor \param e ends.
+ * @param e the editor.
+ * @param pos the offset.
+ * @return the offset after the word.
+ */
+size_t wordAfter(LineEditor *e, size_t pos) {
+    while (pos < e->line.length && isspace((unsigned char)e->line.text[pos])) {
+        pos++;
+    }
+    while (pos < e->line.length && !isspace((unsigned char)e->line.text[pos])) {
+        pos++;
+    }
+    return pos;
+}
+
+/**
+ * Runs an incremental reverse search through the history for editor \param e, as started
+ * by Ctrl-R. Every typed character narrows the search, which continues from the current
+ * match, so no entry is looked at twice while the query grows; Ctrl-R moves on to an
+ * older match. Ctrl-G and Ctrl-C give up the search; any other key takes the match into
+ * the line and is then handled by the editor as usual.
+ * @param e the editor.
+ * @return the key that ended the search, or KEY_NONE.
+ */
+int reverseSearch(LineEditor *e) {
+    EditBuffer query = {NULL, 0, 0}, prompt = {NULL, 0, 0}, shown = {NULL, 0, 0};
+    long count = updateHistoryIndex(&history);
+    long match = -1;
+    size_t offset = 0;
+    bool failed = false;
+    int key;
+
+    while (true) {
+        char *label = failed ? FAILED_SEARCH_PROMPT : SEARCH_PROMPT;
+        prompt.length = 0;
+        appendEdit(&prompt, label, strlen(label));
+        appendEdit(&prompt, query.text, query.length);
+        appendEdit(&prompt, "': ", 4);  // including the NUL
+        shown.length = 0;
+        size_t length;
+        char *entry = match == -1 ? NULL : historyEntry(&history, match, &length);
+        if (entry != NULL) {
+            appendEdit(&shown, entry, length);
+        }
+        refreshLine(prompt.text, &shown, entry != NULL ? offset : 0);
+
+        key = readKey();
+        long from;
+        if (key == CTRL_KEY('R')) {
+            if (query.length == 0 || match <= 0) {
+                failed = query.length > 0;
+                continue;
+            }
+            from = match - 1;
+        } else if (key == 127 || key == CTRL_KEY('H')) {
+            if (query.length > 0) {
+                query.length--;
+            }
+            from = count - 1;
+            failed = false;
+        } else if (key >= ' ' && key < KEY_NONE) {
+            char c = key;
+            appendEdit(&query, &c, 1);
+            if (failed) {   // a longer query does not match either
+                continue;
+            }
+            from = match == -1 ? count - 1 : match;
+        } else {
+            break;
+        }
+
+        if (query.length == 0) {
+            match = -1;
+            continue;
+        }
+        long found = searchHistory(&history, query.text, query.length, from);
+        failed = found == -1;
+        if (!failed) {
+            match = found;
+            entry = historyEntry(&history, match, &length);
+            offset = (char *)memmem(entry, length, query.text, query.length) - entry;
+        }
+    }
+
+    if (key == CTRL_KEY('G') || key == CTRL_KEY('C')) {
+        key = KEY_NONE;
+    } else if (match != -1 && shown.length > 0) {
+        replaceLine(e, shown.text, shown.length);
+        e->cursor = offset;
+        e->historyPos = -1;
+    }
+    free(query.text);
+    free(prompt.text);
+    free(shown.text);
+    return key;
+}
+
+/**
+ * Reads one line from the terminal into editor \param e, which must be in raw mode,
+ * handling the editing keys: the cursor keys, Home/Ctrl-A, End/Ctrl-E, Backspace,
+ * Delete, Ctrl-K, Ctrl-U, Ctrl-W, Ctrl-L, Up/Ctrl-P and Down/Ctrl-N for the history and
+ * Ctrl-R for a reverse search.
+ * @param e the editor.
+ * @return EDIT_DONE for Enter, EDIT_EOF for Ctrl-D on an empty line and EDIT_CANCEL for
+ * Ctrl-C.
+ */
+enum EditResult readEditedLine(LineEditor *e) {
+    e->line.length = 0;
+    e->cursor = 0;
+    e->historyPos = -1;
+    refreshLine(e->prompt, &e->line, e->cursor);
+
+    while (true) {
+        int key = readKey();
+        if (key == CTRL_KEY('R')) {
+            key = reverseSearch(e);
+        }
+
+        switch (key) {
+        case '\r':
+        case '\n':
+            refreshLine(e->prompt, &e->line, e->line.length);
+            writeAll(STDERR_FILENO, "\r\n", 2);
+            return EDIT_DONE;
+        case -1:
+            writeAll(STDERR_FILENO, "\r\n", 2);
+            return EDIT_EOF;
+        case CTRL_KEY('D'):
+            if (e->line.length == 0) {
+                writeAll(STDERR_FILENO, "\r\n", 2);
+                return EDIT_EOF;
+            }
+            // fall through
+        case KEY_DELETE:
+            if (e->cursor < e->line.length) {
+                eraseEdit(&e->line, e->cursor, 1);
+            }
+            break;
+        case CTRL_KEY('C'):
+            writeAll(STDERR_FILENO, "^C\r\n", 4);
+            return EDIT_CANCEL;
+        case 127:
+        case CTRL_KEY('H'):
+            if (e->cursor > 0) {
+                eraseEdit(&e->line, --e->cursor, 1);
+            }
+            break;
+        case CTRL_KEY('A'):
+        case KEY_HOME:
+            e->cursor = 0;
+            break;
+        case CTRL_KEY('E'):
+        case KEY_END:
+            e->cursor = e->line.length;
+            break;
+        case CTRL_KEY('B'):
+        case KEY_LEFT:
+            if (e->cursor > 0) {
+                e->cursor--;
+            }
+            break;
+        case CTRL_KEY('F'):
+        case KEY_RIGHT:
+            if (e->cursor < e->line.length) {
+                e->cursor++;
+            }
+            break;
+        case KEY_WORD_LEFT:
+            e->cursor = wordBefore(e, e->cursor);
+            break;
+        case KEY_WORD_RIGHT:
+            e->cursor = wordAfter(e, e->cursor);
+            break;
+        case CTRL_KEY('K'):
+            e->line.length = e->cursor;
+            break;
+        case CTRL_KEY('U'):
+            eraseEdit(&e->line, 0, e->cursor);
+            e->cursor = 0;
+            break;
+        case CTRL_KEY('W'): {
+            size_t start = wordBefore(e, e->cursor);
+            eraseEdit(&e->line, start, e->cursor - start);
+            e->cursor = start;
+            break;
+        }
+        case CTRL_KEY('L'):
+            writeAll(STDERR_FILENO, "\x1b[H\x1b[2J", 7);
+            break;
+        case CTRL_KEY('P'):
+        case KEY_UP:
+            moveInHistory(e, -1);
+            break;
+        case CTRL_KEY('N'):
+        case KEY_DOWN:
+            moveInHistory(e, 1);
+            break;
+        default:
+            if ((key >= ' ' && key < KEY_NONE && key != 127) || key == '\t') {
+                char c = key;
+                insertEdit(&e->line, e->cursor++, &c, 1);
+            }
+            break;
+        }
+        refreshLine(e->prompt, &e->line, e->cursor);
+    }
+}
+
+/**
+ * Checks whether the \param n characters at \param s leave a quote open, so that the
+ * line continues on the next one, as readLine decides for other input.
+ * @param s the characters.
+ * @param n the number of characters.
+ * @return a bool denoting whether a quote is open.
+ */
+bool quoteOpen(char *s, size_t n) {
+    bool open = false;
+
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] == '\"') {
+            open = !open;
+        }
+    }
+    return open;
+}
+
+/**
+ * Reads an inputline from the terminal with line editing, showing prompt \param prompt.
+ * A line with an open quote is continued on the next line, as readLine does. The line is
+ * added to the history unless it is blank. The terminal must be in raw mode; it is
+ * restored afterwards.
+ * @param prompt the prompt.
+ * @return a string containing the inputline, or NULL when EOF is reached. The string
+ * stays valid until the next call.
+ */
+char *editPromptedLine(char *prompt) {
+    LineEditor e;
+    memset(&e, 0, sizeof(e));
+    e.prompt = prompt;
+    result.length = 0;
+    bool eof = false;
+
+    fflush(stdout);     // the editor writes to the terminal directly
+
+    while (true) {
+        enum EditResult r = readEditedLine(&e);
+        if (r == EDIT_CANCEL) {
+            result.length = 0;
+            e.prompt = prompt;
+            continue;
+        }
+        if (r == EDIT_EOF) {
+            eof = result.length == 0;   // an open quote is ended by EOF, as in readLine
+            break;
+        }
+        appendEdit(&result, e.line.text, e.line.length);
+        if (!quoteOpen(result.text, result.length)) {
+            break;
+        }
+        appendEdit(&result, "\n", 1);
+        e.prompt = CONTINUATION_PROMPT;
+    }
+    disableRawMode();
+    free(e.line.text);
+    free(e.draft.text);
+
+    if (eof) {
+        return NULL;
+    }
+    size_t i = 0;
+    while (i < result.length && isspace((unsigned char)result.text[i])) {
+        i++;
+    }
+    if (i < result.length) {
+        addHistory(&history, result.text, result.length);
+    }
+    appendEdit(&result, "", 1);
+    return result.text;
+}
+
+/**
+ * Reads an inputline from the terminal with line editing, showing the prompt $PS1, or
+ * DEFAULT_PROMPT.
+ * @return a string containing the inputline, or NULL when EOF is reached. The string
+ * stays valid until the next call.
+ */
+char *editLine() {
+    if (!historyOpened) {
+        openShellHistory();
+    }
+    if (!enableRawMode()) {
+        return readInputLine();
+    }
+    char *prompt = getVariable("PS1", 3);
+    return editPromptedLine(prompt != NULL ? prompt : DEFAULT_PROMPT);
+}
+
+/**
+ * Reads a line that continues an inputline, such as the next line of a loop, with line
+ * editing, showing CONTINUATION_PROMPT.
+ * @param r the reader that the line is read from when the terminal does not support
+ * editing after all.
+ * @return a string containing the line, or NULL when EOF is reached. The string stays
+ * valid until the next call.
+ */
+char *editContinuation(InputReader *r) {
+    if (!enableRawMode()) {
+        return readLine(r);
+    }
+    return editPromptedLine(CONTINUATION_PROMPT);
+}
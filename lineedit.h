@@ -0,0 +1,62 @@
+#ifndef SHELL_LINEEDIT_H
+#define SHELL_LINEEDIT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "scanner.h"
+
+#define INITIAL_EDIT_SIZE 256
+#define DEFAULT_PROMPT "$ "
+#define CONTINUATION_PROMPT "> "
+#define SEARCH_PROMPT "(reverse-i-search)`"
+#define FAILED_SEARCH_PROMPT "(failed reverse-i-search)`"
+#define DEFAULT_COLUMNS 80
+
+#define CTRL_KEY(c) ((c) & 0x1f)
+
+// keys that are sent as escape sequences
+enum Key {
+    KEY_NONE = 256,
+    KEY_UP,
+    KEY_DOWN,
+    KEY_LEFT,
+    KEY_RIGHT,
+    KEY_HOME,
+    KEY_END,
+    KEY_DELETE,
+    KEY_WORD_LEFT,
+    KEY_WORD_RIGHT
+};
+
+// how reading a line ended
+enum EditResult {
+    EDIT_DONE,
+    EDIT_EOF,
+    EDIT_CANCEL
+};
+
+// a growable string
+typedef struct EditBuffer {
+    char *text;
+    size_t length;
+    size_t size;
+} EditBuffer;
+
+// the state of the line that is being edited
+typedef struct LineEditor {
+    char *prompt;
+    EditBuffer line;
+    size_t cursor;
+    long historyPos;    // the history entry that is shown, or -1 while editing a new line
+    size_t historyCount;
+    EditBuffer draft;   // the new line, while a history entry is shown
+} LineEditor;
+
+bool canEditLines();
+
+char *editLine();
+
+char *editContinuation(InputReader *r);
+
+#endif
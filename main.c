@@ -1,55 +1,156 @@
-#include <stdlib.h>
-#include <stdio.h>
-#include <stdbool.h>
-#include <string.h>
-#include <unistd.h>
-#include <sys/types.h>  
-#include <sys/wait.h>
-
-#include "scanner.h"
-#include "shell.h"
-
-int main(int argc, char *argv[]) {
-    char *inputLine;
-    List tokenList;
-    List t;
-   
-   //so things print in order 
-    setbuf(stdin, NULL);
-    setbuf(stdout, NULL);
-
-
-   
-    while (true) {
-        inputLine = readInputLine();
-
-        if(!inputLine){
-            break;
-        }
-
-        tokenList = getTokenList(inputLine);
-        t= tokenList;
-
-        bool parsedSuccessfully = parseInputLine(&tokenList);
-        
-      
-        if (tokenList == NULL && parsedSuccessfully) {
-
-            // Input was parsed successfully and can be accessed in "tokenList"
-
-            // However, this is still a simple list of strings, it might be convenient
-            // to build some intermediate structure representing the input line or a
-            // command that you then construct in the parsing logic. It's up to you
-            // to determine how to approach this!
-        } else {
-            printf("Error: invalid syntax!\n");
-            exit(1);
-        }
-
-        free(inputLine);
-        freeTokenList(t);
-
-        }
-    
-    return 0;
-}
\ No newline at end of file
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>  
+#include <sys/wait.h>
+
+#include "scanner.h"
+#include "shell.h"
+#include "exec.h"
+#include "script.h"
+#include "jobs.h"
+#include "lineedit.h"
+#include "variables.h"
+
+/**
+ * Runs command string \param command, the argument of -c, line by line. The lines are
+ * tokenized where they are, so the string is read without being copied.
+ * @param command the command string.
+ * @param arena the arena that holds the tokens and the parse tree of the current line.
+ */
+void runCommandString(char *command, Arena *arena) {
+    InputReader reader;
+    LineSource source = {&reader, readLine};
+    char *inputLine;
+
+    initStringReader(&reader, command);
+    while ((inputLine = readLine(&reader)) != NULL) {
+        List tokenList = getTokenList(inputLine, arena);
+        InputLine line;
+
+        if (!parseContinuedLine(&tokenList, &line, &source, arena) || tokenList != NULL) {
+            printf("Error: invalid syntax!\n");
+            exit(1);
+        }
+        readHereDocuments(&line, &reader, arena);
+        lastInProcess = inputEnded(&reader);    // the last command can replace the shell
+        runInputLine(&line);
+        arenaReset(arena);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    char *inputLine;
+    List tokenList;
+    Arena lineArena = {NULL};   // holds the tokens and the parse tree of the current line
+    char *scriptFile = NULL;
+    char *command = NULL;
+    int maxJobs = 0;
+    int opt;
+
+    while ((opt = getopt(argc, argv, "+c:f:j:")) != -1) {
+        switch (opt) {
+        case 'c':
+            command = optarg;
+            break;
+        case 'f':
+            scriptFile = optarg;
+            break;
+        case 'j':
+            maxJobs = atoi(optarg);
+            if (maxJobs >= 1) {
+                break;
+            }
+            // fall through
+        default:
+            fprintf(stderr, "Usage: %s [-j jobs] [-f script | -c command] [args...]\n", argv[0]);
+            exit(2);
+        }
+    }
+    if (command != NULL && scriptFile != NULL) {
+        fprintf(stderr, "Usage: %s [-j jobs] [-f script | -c command] [args...]\n", argv[0]);
+        exit(2);
+    }
+
+    // $0 is the script, or for -c the first operand, and the other operands are $1, $2, ...
+    if (scriptFile != NULL) {
+        argv[optind - 1] = scriptFile;
+        setPositional(argv + optind - 1, argc - optind + 1);
+    } else if (command != NULL && optind < argc) {
+        setPositional(argv + optind, argc - optind);
+    } else {
+        setPositional(argv, 1);
+    }
+
+    interactive = scriptFile == NULL && command == NULL && maxJobs == 0 && isatty(STDIN_FILENO);
+    bool editing = interactive && canEditLines();
+    initExecutor();
+
+    if (command != NULL && maxJobs == 0) {
+        runCommandString(command, &lineArena);
+        return last;
+    }
+
+    // batch mode: parse the script once, then run it from the parse trees
+    if (scriptFile != NULL || command != NULL || maxJobs > 0) {
+        Script script;
+        InputReader reader;
+        if (command != NULL) {
+            initStringReader(&reader, command);
+            readScript(&script, &reader);
+        } else if (scriptFile == NULL) {
+            readScript(&script, getStdinReader());
+        } else if (!loadScript(&script, scriptFile)) {
+            printf("Error: cannot open script %s\n", scriptFile);
+            exit(127);
+        }
+
+        if (maxJobs == 0) {
+            runScript(&script);
+        } else if (validScript(&script)) { // -j: the lines are independent and run in parallel
+            last = runScriptParallel(&script, maxJobs);
+        } else {
+            printf("Error: invalid syntax!\n");
+            exit(1);
+        }
+        freeScript(&script);
+        return last;    // as when the final command replaced the shell
+    }
+
+
+   
+    while (true) {
+        notifyJobs();
+        inputLine = editing ? editLine() : readInputLine();
+
+        if(!inputLine){
+            break;
+        }
+
+        // the bodies of here-documents and the lines that the inputline continues on are
+        // read into the same buffer as the line, so the tokens must not point into it
+        inputLine = arenaStrndup(&lineArena, inputLine, strlen(inputLine));
+        tokenList = getTokenList(inputLine, &lineArena);
+
+        InputLine line;
+        LineSource source = {getStdinReader(), editing ? editContinuation : readLine};
+        bool parsedSuccessfully = parseContinuedLine(&tokenList, &line, &source, &lineArena);
+
+        if (tokenList == NULL && parsedSuccessfully) {
+            // Input was parsed successfully into the parse tree in "line"
+            readHereDocuments(&line, getStdinReader(), &lineArena);
+            runInputLine(&line);
+        } else {
+            printf("Error: invalid syntax!\n");
+            exit(1);
+        }
+
+        arenaReset(&lineArena);
+
+        }
+    
+    arenaFree(&lineArena);
+    return 0;
+}
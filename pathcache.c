@@ -0,0 +1,253 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "hash.h"
+#include "pathcache.h"
+#include "variables.h"
+
+// open addressing hash table (linear probing) of resolved commands
+PathEntry *pathCache = NULL;
+size_t pathCacheSize = 0;
+size_t numPathEntries = 0;
+
+// the value of PATH that the cached entries were resolved with
+char *cachedPath = NULL;
+bool pathChecked = false;
+
+/**
+ * Searches the directories in PATH for an executable file called \param name, in the
+ * same order as execvp does.
+ * @param name the command name.
+ * @return the absolute path as a newly allocated string, or NULL when it is not found.
+ */
+char *findInPath(char *name) {
+    char *path = getVariable("PATH", 4);
+    if (path == NULL) {
+        path = "/usr/local/bin:/bin:/usr/bin";
+    }
+
+    size_t nameLen = strlen(name);
+    char *candidate = malloc(strlen(path) + nameLen + 3);
+    assert(candidate != NULL);
+
+    while (true) {
+        char *end = strchr(path, ':');
+        size_t dirLen = end == NULL ? strlen(path) : (size_t)(end - path);
+
+        if (dirLen == 0) { // an empty entry means the working directory
+            memcpy(candidate, ".", 1);
+            dirLen = 1;
+        } else {
+            memcpy(candidate, path, dirLen);
+        }
+        candidate[dirLen] = '/';
+        memcpy(candidate + dirLen + 1, name, nameLen + 1);
+
+        struct stat st;
+        if (stat(candidate, &st) == 0 && S_ISREG(st.st_mode) && access(candidate, X_OK) == 0) {
+            return candidate;
+        }
+
+        if (end == NULL) {
+            break;
+        }
+        path = end + 1;
+    }
+    free(candidate);
+    return NULL;
+}
+
+/**
+ * Drops every entry of the cache.
+ */
+void clearPathCache() {
+    for (size_t i = 0; i < pathCacheSize; i++) {
+        if (pathCache[i].name != NULL) {
+            free(pathCache[i].name);
+            free(pathCache[i].path);
+            pathCache[i].name = NULL;
+        }
+    }
+    numPathEntries = 0;
+}
+
+/**
+ * Empties the cache when PATH no longer has the value the entries were resolved with.
+ */
+void checkPath() {
+    char *path = getVariable("PATH", 4);
+
+    if (pathChecked && (cachedPath == NULL ? path == NULL : path != NULL && strcmp(cachedPath, path) == 0)) {
+        return;
+    }
+    clearPathCache();
+    free(cachedPath);
+    cachedPath = path == NULL ? NULL : strdup(path);
+    pathChecked = true;
+}
+
+/**
+ * Finds the slot of \param name in the cache: the slot that holds it, or the empty slot
+ * where it belongs.
+ * @param name the command name.
+ * @param hash the hash of \param name.
+ * @return the index of the slot.
+ */
+size_t findSlot(char *name, unsigned long hash) {
+    size_t i = hash & (pathCacheSize - 1);
+    while (pathCache[i].name != NULL &&
+           (pathCache[i].hash != hash || strcmp(pathCache[i].name, name) != 0)) {
+        i = (i + 1) & (pathCacheSize - 1);
+    }
+    return i;
+}
+
+/**
+ * Doubles the size of the cache and rehashes its entries.
+ */
+void growPathCache() {
+    PathEntry *old = pathCache;
+    size_t oldSize = pathCacheSize;
+
+    pathCacheSize = oldSize == 0 ? INITIAL_PATH_CACHE_SIZE : 2 * oldSize;
+    pathCache = calloc(pathCacheSize, sizeof(*pathCache));
+    assert(pathCache != NULL);
+
+    for (size_t i = 0; i < oldSize; i++) {
+        if (old[i].name != NULL) {
+            pathCache[findSlot(old[i].name, old[i].hash)] = old[i];
+        }
+    }
+    free(old);
+}
+
+/**
+ * Resolves command \param name to the path of the executable that execvp would run. A
+ * name is searched in PATH only the first time; later lookups are answered from the cache.
+ * Names that contain a slash are not looked up.
+ * @param name the command name.
+ * @return the path of the executable, or NULL when it is not found. The path is owned by
+ * the cache.
+ */
+char *lookupCommand(char *name) {
+    if (strchr(name, '/') != NULL) {
+        return name;
+    }
+
+    checkPath();
+    if (2 * (numPathEntries + 1) > pathCacheSize) { // keep the load factor below 1/2
+        growPathCache();
+    }
+
+    unsigned long hash = hashString(name, strlen(name));
+    size_t i = findSlot(name, hash);
+    if (pathCache[i].name == NULL) {
+        char *path = findInPath(name);
+        if (path == NULL) {
+            return NULL;    // not cached, it may be installed later
+        }
+        pathCache[i].name = strdup(name);
+        pathCache[i].path = path;
+        pathCache[i].hash = hash;
+        pathCache[i].hits = 0;
+        numPathEntries++;
+    }
+    pathCache[i].hits++;
+    return pathCache[i].path;
+}
+
+/**
+ * Removes command \param name from the cache, for instance because executing the cached
+ * path failed. The entries after it are moved back so that probing still finds them.
+ * @param name the command name.
+ */
+void forgetCommand(char *name) {
+    if (pathCacheSize == 0) {
+        return;
+    }
+
+    size_t i = findSlot(name, hashString(name, strlen(name)));
+    if (pathCache[i].name == NULL) {
+        return;
+    }
+    free(pathCache[i].name);
+    free(pathCache[i].path);
+    pathCache[i].name = NULL;
+    numPathEntries--;
+
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & (pathCacheSize - 1);
+        if (pathCache[j].name == NULL) {
+            break;
+        }
+        size_t home = pathCache[j].hash & (pathCacheSize - 1);
+        // move the entry into the hole unless its home slot lies cyclically in (i, j]
+        if ((j > i && (home <= i || home > j)) || (j < i && (home <= i && home > j))) {
+            pathCache[i] = pathCache[j];
+            pathCache[j].name = NULL;
+            i = j;
+        }
+    }
+}
+
+/**
+ * Prints the cached commands with the number of times they were used.
+ */
+void printPathCache() {
+    if (numPathEntries == 0) {
+        printf("hash: hash table empty\n");
+        return;
+    }
+    printf("hits\tcommand\n");
+    for (size_t i = 0; i < pathCacheSize; i++) {
+        if (pathCache[i].name != NULL) {
+            printf("%4d\t%s\n", pathCache[i].hits, pathCache[i].path);
+        }
+    }
+}
+
+/**
+ * Builds the argument list that runs file \param path with FALLBACK_SHELL, which is how
+ * execvp runs a file that the kernel cannot execute, such as a script without "#!".
+ * @param path the path of the file.
+ * @param argv the argument list of the file.
+ * @return the argument list, newly allocated; the strings are not copied.
+ */
+char **scriptArguments(char *path, char **argv) {
+    int argc = 0;
+    while (argv[argc] != NULL) {
+        argc++;
+    }
+
+    char **args = malloc((argc + 2) * sizeof(*args));
+    assert(args != NULL);
+    args[0] = FALLBACK_SHELL;
+    args[1] = path;
+    memcpy(args + 2, argv + 1, argc * sizeof(*args));  // the arguments and the NULL
+    return args;
+}
+
+/**
+ * Executes file \param path like execve, but runs it with FALLBACK_SHELL when the kernel
+ * cannot execute it (ENOEXEC), as execvp does.
+ * @param path the resolved path of the program.
+ * @param argv the argument list of the program.
+ * @param envp the environment of the program.
+ * @return only when the file could not be executed, with errno set.
+ */
+void executePath(char *path, char **argv, char **envp) {
+    execve(path, argv, envp);
+    if (errno == ENOEXEC) {
+        char **args = scriptArguments(path, argv);
+        execve(FALLBACK_SHELL, args, envp);
+        free(args);
+        errno = ENOEXEC;
+    }
+}
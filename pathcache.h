@@ -0,0 +1,31 @@
+#ifndef SHELL_PATHCACHE_H
+#define SHELL_PATHCACHE_H
+
+#define INITIAL_PATH_CACHE_SIZE 64
+
+// runs the files that the kernel cannot execute, as execvp does
+#define FALLBACK_SHELL "/bin/sh"
+
+// a command name that was resolved to an absolute path
+typedef struct PathEntry {
+    char *name;             // NULL for an empty slot
+    char *path;
+    unsigned long hash;
+    int hits;
+} PathEntry;
+
+char *lookupCommand(char *name);
+
+char *findInPath(char *name);
+
+void forgetCommand(char *name);
+
+void clearPathCache();
+
+void printPathCache();
+
+char **scriptArguments(char *path, char **argv);
+
+void executePath(char *path, char **argv, char **envp);
+
+#endif
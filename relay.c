@@ -0,0 +1,177 @@
+#include <stdlib.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "relay.h"
+
+/**
+ * Writes all \param n bytes of \param buf to file descriptor \param fd.
+ * @param fd the file descriptor.
+ * @param buf the data.
+ * @param n number of bytes.
+ * @return a bool denoting whether everything was written.
+ */
+bool writeAll(int fd, char *buf, ssize_t n) {
+    while (n > 0) {
+        ssize_t m = write(fd, buf, n);
+        if (m == -1 && errno == EINTR) {
+            continue;
+        }
+        if (m <= 0) {
+            return false;
+        }
+        buf += m;
+        n -= m;
+    }
+    return true;
+}
+
+/**
+ * Moves up to \param n bytes from pipe \param in to file descriptor \param out with
+ * splice, so that the data does not pass through user space.
+ * @param in the pipe to read from.
+ * @param out the file descriptor to write to.
+ * @param n number of bytes.
+ * @return the number of bytes moved; less than \param n when splicing failed.
+ */
+ssize_t spliceAll(int in, int out, ssize_t n) {
+    ssize_t moved = 0;
+    while (moved < n) {
+        ssize_t m = splice(in, NULL, out, NULL, n - moved, SPLICE_F_MOVE);
+        if (m == -1 && errno == EINTR) {
+            continue;
+        }
+        if (m <= 0) {
+            break;
+        }
+        moved += m;
+    }
+    return moved;
+}
+
+/**
+ * Copies exactly \param n bytes from \param in to \param out through a buffer.
+ * @param in the file descriptor to read from.
+ * @param out the file descriptor to write to.
+ * @param n number of bytes.
+ * @return a bool denoting whether all bytes were copied.
+ */
+bool copyExactly(int in, int out, ssize_t n) {
+    char buf[4096];
+    while (n > 0) {
+        ssize_t m = read(in, buf, n < (ssize_t)sizeof(buf) ? n : (ssize_t)sizeof(buf));
+        if (m == -1 && errno == EINTR) {
+            continue;
+        }
+        if (m <= 0 || !writeAll(out, buf, m)) {
+            return false;
+        }
+        n -= m;
+    }
+    return true;
+}
+
+/**
+ * Copies the input to both outputs through a buffer in user space. This is used when the
+ * kernel cannot splice between the file descriptors (for instance to a terminal).
+ * @param in the file descriptor to read from.
+ * @param out the first output.
+ * @param fileFd the second output.
+ * @return 0 on success, 1 on an error.
+ */
+int copyData(int in, int out, int fileFd) {
+    char *buf = malloc(RELAY_CHUNK_SIZE);
+    if (buf == NULL) {
+        return 1;
+    }
+
+    int status = 0;
+    while (true) {
+        ssize_t n = read(in, buf, RELAY_CHUNK_SIZE);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n <= 0) {
+            status = n == 0 ? 0 : 1;
+            break;
+        }
+        if (!writeAll(fileFd, buf, n) || !writeAll(out, buf, n)) {
+            status = 1;
+            break;
+        }
+    }
+    free(buf);
+    return status;
+}
+
+/**
+ * Copies everything that arrives on pipe \param in both to \param out and to the file
+ * \param fileFd, until EOF. tee(2) duplicates the data in the pipe onto an output pipe
+ * and splice(2) then moves the same bytes into the file, so the data never crosses into
+ * user space. When \param out is not a pipe, the duplicate goes through an intermediate
+ * pipe that is spliced to \param out. If the kernel refuses to splice, the remaining data
+ * is copied through a buffer instead.
+ * @param in the pipe to read from.
+ * @param out where the data continues, for instance the next command of the pipeline.
+ * @param fileFd the file that receives a copy.
+ * @return 0 on success, 1 on an error.
+ */
+int relayData(int in, int out, int fileFd) {
+    int mid[2] = {-1, -1};
+    int teeFd = out;
+    int status = 0;
+
+    while (true) {
+        ssize_t n = tee(in, teeFd, RELAY_CHUNK_SIZE, 0);
+        if (n == -1 && errno == EINTR) {
+            continue;
+        }
+        if (n == -1 && errno == EINVAL && teeFd == out && mid[0] == -1) {
+            if (pipe(mid) == 0) {   // out is not a pipe: tee into a pipe of our own
+                teeFd = mid[1];
+                continue;
+            }
+        }
+        if (n == -1 && errno == EINVAL) {   // in is not a pipe, or nothing can be spliced
+            status = copyData(in, out, fileFd);
+            break;
+        }
+        if (n <= 0) {
+            status = n == 0 ? 0 : 1;
+            break;
+        }
+
+        // if the kernel refuses to splice, the bytes that were not moved are copied
+        bool fallBack = false;
+        if (teeFd != out) {
+            ssize_t moved = spliceAll(mid[0], out, n);
+            if (moved < n) {
+                fallBack = true;
+                if (!copyExactly(mid[0], out, n - moved)) {
+                    status = 1;
+                    break;
+                }
+            }
+        }
+        ssize_t moved = spliceAll(in, fileFd, n);
+        if (moved < n) {
+            fallBack = true;
+            if (!copyExactly(in, fileFd, n - moved)) {
+                status = 1;
+                break;
+            }
+        }
+        if (fallBack) {
+            status = copyData(in, out, fileFd);
+            break;
+        }
+    }
+
+    if (mid[0] != -1) {
+        close(mid[0]);
+        close(mid[1]);
+    }
+    return status;
+}
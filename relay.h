@@ -0,0 +1,13 @@
+#ifndef SHELL_RELAY_H
+#define SHELL_RELAY_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+
+#define RELAY_CHUNK_SIZE 65536
+
+bool writeAll(int fd, char *buf, ssize_t n);
+
+int relayData(int in, int out, int fileFd);
+
+#endif
@@ -1,221 +1,555 @@
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <ctype.h>
-#include <assert.h>
-#include <stdbool.h>
-
-#include "scanner.h"
-
-int initExit= 0;
-
-
-/**
- * Reads an inputline from stdin.
- * @return a string containing the inputline.
- */
-char *readInputLine() {
-    int strLen = INITIAL_STRING_SIZE;
-    int c = getchar();
-    int i = 0;
-
-    // exit if EOF reached, no string 
-    if(c == EOF){
-        initExit= -1;
-        return "";
-    }
-
-    char *s = malloc((strLen + 1) * sizeof(*s));
-    assert(s != NULL);
-
-    bool quoteStarted = false;
-    while (c != '\n' || quoteStarted) { // Ensure that newlines in strings are accepted
-        if (c == '\"') {
-            quoteStarted = !quoteStarted;
-        }
-        s[i++] = c;
-
-        if (i >= strLen) { // Resize the string if necessary
-            strLen = 2 * strLen;
-            s = realloc(s, (strLen + 1) * sizeof(*s));
-            assert(s != NULL);
-        }
-
-        c= getchar();
-        
-        // check for EOF again
-        if(c == EOF){
-            initExit= -1;
-            return "";
-        }
-    }
-    
-    s[i] = '\0';
-    return s;
-}
-
-/**
- * The function isOperatorCharacter checks whether the input paramater \param c is an operator.
- * @param c input character.
- * @return a bool denoting whether \param c is an operator.
- */
-bool isOperatorCharacter(char c) {
-    return c == '&' || c == '|' || c == ';' || c == '<' || c == '>';
-}
-
-/**
- * Reads an identifier in string \param s starting at index \param start.
- * @param s input string.
- * @param start starting index in string \param s.
- * @return a pointer to the start of the identifier string
- */
-char *matchIdentifier(char *s, int *start) {
-    int strLen = INITIAL_STRING_SIZE;
-    int pos = 0, offset = 0;
-
-    char *ident = malloc((strLen + 1) * sizeof(*ident));
-    assert(ident != NULL);
-
-    bool quoteStarted = false;
-    int len = strlen(s);
-    while ((!isspace(s[*start + offset]) && !isOperatorCharacter(s[*start + offset])) || quoteStarted) { // Ensure that whitespace in strings is accepted
-        if (s[*start + offset] == '\"') { // Strip the quotes from the input before storing in the identifier
-            quoteStarted = !quoteStarted;
-            offset++;
-            continue;
-        }
-        ident[pos++] = s[*start + offset++];
-        if (*start + offset >= len) { // Identifiers of size 1
-            break;
-        }
-        if (pos >= strLen) { // Resize the string if necessary
-            strLen = 2 * strLen;
-            ident = realloc(ident, (strLen + 1) * sizeof(*ident));
-            assert(ident != NULL);
-        }
-    }
-    ident[pos] = '\0';
-    *start = *start + offset;
-    return ident;
-}
-
-/**
- * The function newNode makes a new node for the token list and fills it with the token that
- * has been read. Precondition: !isspace(a[*ip]).
- * @param s input string.
- * @param start starting index in string \param s.
- * @return a list node that contains the current token.
- */
-List newNode(char *s, int *start) {
-    List node = malloc(sizeof(*node));
-    assert(node != NULL);
-    node->next = NULL;
-    node->t = matchIdentifier(s, start);
-    return node;
-}
-
-/**
- * Reads an operator in string \param s starting at index \param start.
- * @param s input string.
- * @param start starting index in string \param s.
- * @return a pointer to the start of the operator string.
- */
-char *matchOperator(char *s, int *start) {
-    int strLen = 2; // the operator consists of *at most* 2 characters
-    int pos = 0, offset = 0;
-
-    char *op = malloc((strLen + 1) * sizeof(*op));
-    assert(op != NULL);
-
-    while (isOperatorCharacter(s[*start + offset])) {
-        op[pos++] = s[*start + offset++];
-    }
-    op[pos] = '\0';
-    *start = *start + offset;
-    return op;
-}
-
-/**
- * The function newOperatorNode makes a new operator node for the token list and fills it with the token that
- * has been read. Precondition: !isspace(a[*ip]).
- * @param s input string.
- * @param start starting index in string \param s.
- * @return a list node that contains the current token.
- */
-List newOperatorNode(char *s, int *start) {
-    List node = malloc(sizeof(*node));
-    assert(node != NULL);
-    node->next = NULL;
-    node->t = matchOperator(s, start);
-    return node;
-}
-
-/**
- * The function tokenList reads an array and puts the tokens that are read in a list.
- * @param s input string.
- * @return a pointer to the beginning of the list.
- */
-List getTokenList(char *s) {
-    List lastNode = NULL;
-    List node = NULL;
-    List tl = NULL;
-    int i = 0;
-    int length = strlen(s);
-    while (i < length) {
-        if (isspace(s[i])) { // spaces are skipped
-            i++;
-        }else {
-            node = isOperatorCharacter(s[i]) ? newOperatorNode(s, &i) : newNode(s, &i);
-            if (lastNode == NULL) { // there is no list yet
-                tl = node;
-            } else { // a list already exists; add current node at the end
-                (lastNode)->next = node;
-            }
-            lastNode = node;
-        }
-    }
-    return tl;
-}
-
-/**
- * Checks whether list \param l is empty.
- * @param l input list.
- * @return a bool denoting whether \param l is empty.
- */
-bool isEmpty(List l) {
-    return l == NULL;
-}
-
-/**
- * The function printList prints the tokens in a token list, separated by commas.
- * @param li the input list to be printed.
- */
-void printList(List li) {
-    if (li == NULL) return;
-    printf("\"%s\"", li->t);
-    li = li->next;
-    while (li != NULL) {
-        printf(", \"%s\"", li->t);
-        li = li->next;
-    }
-    printf("\n");
-}
-
-/**
- * The function freeTokenlist frees the memory of the nodes of the list, and of the strings
- * in the nodes.
- * @param li the starting node of a list.
- */
-void freeTokenList(List li) {
-    if (li == NULL) {
-        return;
-    }
-    free(li->t);
-    freeTokenList(li->next);
-    free(li);
-}
-
-//function that returns whether exit should be initialized 
-int eofExit(){
-    return initExit;
-}
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+
+#include "scanner.h"
+#include "wildcard.h"
+
+int initExit= 0;
+
+
+// the reader that readInputLine uses for stdin
+InputReader stdinReader;
+bool stdinReaderInitialised = false;
+
+/**
+ * Initialises reader \param r for file descriptor \param fd. When \param fd refers to a
+ * regular file, the remainder of the file is mapped into memory, so that reading lines
+ * from it does not need any further system calls. Otherwise the input is read in blocks
+ * of INPUT_BLOCK_SIZE bytes.
+ * @param r the reader to initialise.
+ * @param fd the file descriptor to read from.
+ */
+void initInputReader(InputReader *r, int fd) {
+    struct stat st;
+    off_t offset = lseek(fd, 0, SEEK_CUR);
+
+    r->fd = fd;
+    r->start = r->end = r->scan = 0;
+    r->quoteStarted = false;
+    r->eof = false;
+    r->mapped = false;
+    r->seekable = offset != -1 && !isatty(fd);
+    r->synced = 0;
+    r->childMayRead = false;
+    r->tail = NULL;
+
+    if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && offset != -1 && st.st_size > offset) {
+        // private writable mapping: the tokenizer rewrites the lines in place
+        void *map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        if (map != MAP_FAILED) {
+            madvise(map, st.st_size, MADV_SEQUENTIAL);
+            r->buf = map;
+            r->size = r->end = st.st_size;
+            r->start = r->scan = r->synced = offset;
+            r->mapped = true;
+            r->eof = true;
+            return;
+        }
+    }
+
+    r->size = INPUT_BLOCK_SIZE;
+    r->buf = malloc((r->size + 1) * sizeof(*r->buf)); // room for the NUL of an unterminated last line
+    assert(r->buf != NULL);
+}
+
+/**
+ * Initialises reader \param r for the lines of string \param s, such as the command
+ * string of -c. The string itself is the buffer: the lines are handed out in place and
+ * stay valid as long as \param s does, so the reader needs no closeInputReader.
+ * @param r the reader to initialise.
+ * @param s the string, which the reader modifies.
+ */
+void initStringReader(InputReader *r, char *s) {
+    r->fd = -1;
+    r->buf = s;
+    r->size = r->end = strlen(s);
+    r->start = r->scan = 0;
+    r->quoteStarted = false;
+    r->eof = true;
+    r->mapped = false;
+    r->seekable = false;
+    r->synced = 0;
+    r->childMayRead = false;
+    r->tail = NULL;
+}
+
+/**
+ * Checks whether reader \param r has handed out all of its input.
+ * @param r the reader.
+ * @return a bool denoting whether no line is left.
+ */
+bool inputEnded(InputReader *r) {
+    return r->eof && r->start == r->end;
+}
+
+/**
+ * Reads the next block of input into the buffer of reader \param r, moving the
+ * unconsumed part of the buffer to the front and growing the buffer when it is full.
+ * @param r the reader.
+ */
+void fillInputReader(InputReader *r) {
+    if (r->start > 0) { // the lines before start have been handed out already
+        memmove(r->buf, r->buf + r->start, r->end - r->start);
+        r->end -= r->start;
+        r->scan -= r->start;
+        r->start = 0;
+    }
+    if (r->end == r->size) { // Resize the buffer if necessary
+        r->size = 2 * r->size;
+        r->buf = realloc(r->buf, (r->size + 1) * sizeof(*r->buf));
+        assert(r->buf != NULL);
+    }
+
+    fflush(stdout);     // the shell may block now, so what it has written must be seen
+    ssize_t n;
+    do {
+        n = read(r->fd, r->buf + r->end, r->size - r->end);
+    } while (n == -1 && errno == EINTR);
+
+    if (n <= 0) {
+        r->eof = true;
+    } else {
+        r->end += n;
+    }
+}
+
+/**
+ * Reads the next line from reader \param r. Complete lines that are already buffered are
+ * returned without a system call.
+ * @param r the reader.
+ * @param quotes whether newlines inside quotes do not end the line.
+ * @return a string containing the line, or NULL when EOF is reached. The string is owned
+ * by the reader and stays valid until the next call.
+ */
+char *nextLine(InputReader *r, bool quotes) {
+    free(r->tail);
+    r->tail = NULL;
+
+    if (r->childMayRead) { // continue where a child that read from the input stopped
+        off_t offset = lseek(r->fd, 0, SEEK_CUR);
+        if (offset != r->synced && offset >= 0 && (size_t)offset <= r->end) {
+            r->start = r->scan = r->synced = offset;
+            r->quoteStarted = false;
+        }
+        r->childMayRead = false;
+    }
+
+    while (true) {
+        for (size_t i = r->scan; i < r->end; i++) {
+            if (r->buf[i] == '\"' && quotes) {
+                r->quoteStarted = !r->quoteStarted;
+            } else if (r->buf[i] == '\n' && !r->quoteStarted) { // Ensure that newlines in strings are accepted
+                char *line = r->buf + r->start;
+                r->buf[i] = '\0';
+                r->start = r->scan = i + 1;
+                return line;
+            }
+        }
+        r->scan = r->end;
+
+        if (r->eof) {
+            break;
+        }
+        fillInputReader(r);
+    }
+
+    // exit if EOF reached, no string
+    if (r->start == r->end) {
+        initExit = -1;
+        return NULL;
+    }
+
+    // the last line is not terminated by a newline
+    r->quoteStarted = false;
+    size_t len = r->end - r->start;
+    char *line = r->buf + r->start;
+    r->start = r->scan = r->end;
+    if (r->mapped) { // there may be no room after the mapping for the NUL
+        r->tail = malloc((len + 1) * sizeof(*r->tail));
+        assert(r->tail != NULL);
+        memcpy(r->tail, line, len);
+        line = r->tail;
+    }
+    line[len] = '\0';
+    return line;
+}
+
+/**
+ * Reads the next inputline from reader \param r. Newlines inside quotes do not end the
+ * line.
+ * @param r the reader.
+ * @return a string containing the inputline, or NULL when EOF is reached. The string is
+ * owned by the reader and stays valid until the next call.
+ */
+char *readLine(InputReader *r) {
+    return nextLine(r, true);
+}
+
+/**
+ * Reads the next line from reader \param r as it is, such as a line of a here-document.
+ * @param r the reader.
+ * @return a string containing the line, or NULL when EOF is reached. The string is owned
+ * by the reader and stays valid until the next call.
+ */
+char *readRawLine(InputReader *r) {
+    return nextLine(r, false);
+}
+
+/**
+ * Moves the file offset of the input of reader \param r back to the start of the input
+ * that has not been handed out yet, so that a child process that inherits the file
+ * descriptor continues reading exactly after the current line. Input that cannot seek
+ * (pipes and terminals) is left as it is.
+ * @param r the reader.
+ */
+void syncInputReader(InputReader *r) {
+    if (!r->seekable) {
+        return;
+    }
+    if (r->mapped) {
+        if (r->synced != r->start) {
+            lseek(r->fd, r->start, SEEK_SET);
+            r->synced = r->start;
+        }
+        r->childMayRead = true;
+    } else if (r->end > r->start) { // forget the read-ahead, it is read again later
+        lseek(r->fd, -(off_t)(r->end - r->start), SEEK_CUR);
+        r->end = r->scan = r->start;
+        r->quoteStarted = false;
+        r->eof = false;
+    }
+}
+
+/**
+ * Releases the buffer or mapping of reader \param r.
+ * @param r the reader.
+ */
+void closeInputReader(InputReader *r) {
+    if (r->mapped) {
+        munmap(r->buf, r->size);
+    } else {
+        free(r->buf);
+    }
+    free(r->tail);
+    r->buf = r->tail = NULL;
+}
+
+/**
+ * Returns the reader for stdin, which is initialised on first use.
+ * @return the reader.
+ */
+InputReader *getStdinReader() {
+    if (!stdinReaderInitialised) {
+        initInputReader(&stdinReader, STDIN_FILENO);
+        stdinReaderInitialised = true;
+    }
+    return &stdinReader;
+}
+
+/**
+ * Reads an inputline from stdin.
+ * @return a string containing the inputline, or NULL when EOF is reached. The string
+ * stays valid until the next call.
+ */
+char *readInputLine() {
+    return readLine(getStdinReader());
+}
+
+/**
+ * Hands the input that stdin has buffered but not consumed yet back to stdin, if possible.
+ * Must be called before a child process is created that may read from stdin.
+ */
+void syncInput() {
+    if (stdinReaderInitialised) {
+        syncInputReader(&stdinReader);
+    }
+}
+
+/**
+ * The function isOperatorCharacter checks whether the input paramater \param c is an operator.
+ * @param c input character.
+ * @return a bool denoting whether \param c is an operator.
+ */
+bool isOperatorCharacter(char c) {
+    return c == '&' || c == '|' || c == ';' || c == '<' || c == '>' || c == '(' || c == ')' ||
+           c == '\n';
+}
+
+/**
+ * The operators that the scanner recognises. Longer operators must come before their
+ * prefixes, so that the longest possible operator is matched.
+ */
+static char *operatorTokens[] = {
+    "&&",
+    "||",
+    "|&",
+    "&",
+    "|",
+    ";",
+    "<<<",
+    "<<",
+    "<&",
+    "<",
+    ">>",
+    ">&",
+    ">",
+    "(",
+    ")",
+    "\n",
+    NULL};
+
+/**
+ * Determines the length of the command substitution at the start of string \param s,
+ * which starts with "$(". The substitution ends at the matching ")"; parentheses inside
+ * quotes do not count, and substitutions and subshells may be nested, inside quotes as
+ * well.
+ * @param s input string.
+ * @return the number of characters up to and including the matching ")", or up to the end
+ * of \param s when there is none.
+ */
+size_t substitutionLength(char *s) {
+    bool quoted[MAX_SUBSTITUTION_DEPTH] = {false};  // the quote state at every depth
+    int depth = 1;
+    size_t i = 2;
+
+    while (s[i] != '\0' && depth > 0) {
+        if (s[i] == '\"') {
+            quoted[depth - 1] = !quoted[depth - 1];
+        } else if (s[i] == '$' && s[i + 1] == '(' && depth < MAX_SUBSTITUTION_DEPTH) {
+            quoted[depth++] = false;
+            i++;
+        } else if (s[i] == '(' && !quoted[depth - 1] && depth < MAX_SUBSTITUTION_DEPTH) {
+            quoted[depth++] = false;
+        } else if (s[i] == ')' && !quoted[depth - 1]) {
+            depth--;
+        }
+        i++;
+    }
+    return i;
+}
+
+/**
+ * Checks whether a special parameter follows the "$" at the start of string \param s:
+ * "$?", "$#", "$@", "$*" or a positional parameter "$0" to "$9".
+ * @param s input string.
+ * @return a bool denoting whether \param s starts with a special parameter.
+ */
+bool isSpecialParameter(char *s) {
+    return s[0] == '$' && (s[1] == '?' || s[1] == '#' || s[1] == '@' || s[1] == '*' ||
+                           isdigit((unsigned char)s[1]));
+}
+
+/**
+ * Checks whether an expansion starts at string \param s: "$" followed by "(", "{", the
+ * start of a variable name, or a special parameter.
+ * @param s input string.
+ * @return a bool denoting whether \param s starts with an expansion.
+ */
+bool isExpansion(char *s) {
+    return s[0] == '$' && (s[1] == '(' || s[1] == '{' || s[1] == '_' ||
+                           isalpha((unsigned char)s[1]) || isSpecialParameter(s));
+}
+
+/**
+ * Checks whether the "[" at the start of string \param s is closed by a "]" in the same
+ * word, so that it starts a bracket expression rather than being the test command.
+ * @param s the string.
+ * @return a bool denoting whether the bracket is closed.
+ */
+bool hasClosingBracket(char *s) {
+    for (int i = 1; s[i] != '\0' && !isspace(s[i]) && !isOperatorCharacter(s[i]); i++) {
+        if (s[i] == ']') {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Reads an identifier in string \param s starting at index \param start. The identifier is
+ * not copied: quotes are stripped by moving the characters of the identifier to the left,
+ * in place. An identifier that contains an expansion or an unquoted wildcard is kept as
+ * it is instead, quotes included, because the quotes determine how the expanded text is
+ * split and which wildcards match; whitespace and operators inside a command substitution
+ * belong to the identifier. The identifier is not NUL-terminated yet, since the character
+ * directly after it may still be needed by the scanner.
+ * @param s input string.
+ * @param start starting index in string \param s.
+ * @param end set to the position where the terminating NUL has to be written.
+ * @param expand set to whether the identifier contains an expansion.
+ * @return a pointer to the start of the identifier string
+ */
+char *matchIdentifier(char *s, int *start, char **end, bool *expand) {
+    char *ident = s + *start;
+    int pos = *start, offset = *start;
+
+    bool quoteStarted = false;
+    *expand = false;
+    while (s[offset] != '\0' &&
+           ((!isspace(s[offset]) && !isOperatorCharacter(s[offset])) || quoteStarted)) { // Ensure that whitespace in strings is accepted
+        if (s[offset] == '$' && s[offset + 1] == '(') {
+            offset += substitutionLength(s + offset);
+            *expand = true;
+            continue;
+        }
+        if (isExpansion(s + offset)) {
+            *expand = true;
+            if (isSpecialParameter(s + offset)) { // "$?" and "$*" are not wildcards
+                offset += 2;
+                continue;
+            }
+        }
+        if (!quoteStarted && isWildcard(s[offset]) && (s[offset] != '[' || hasClosingBracket(s + offset))) {
+            *expand = true;
+        }
+        if (s[offset] == '\"') {
+            quoteStarted = !quoteStarted;
+        }
+        offset++;
+    }
+
+    if (!*expand) { // Strip the quotes from the input before storing in the identifier
+        for (int i = *start; i < offset; i++) {
+            if (s[i] != '\"') {
+                s[pos++] = s[i];
+            }
+        }
+    } else {
+        pos = offset;
+    }
+    *end = s + pos;
+    *start = offset;
+    return ident;
+}
+
+/**
+ * Reads an operator in string \param s starting at index \param start.
+ * @param s input string.
+ * @param start starting index in string \param s.
+ * @return a pointer to the (statically allocated) operator string.
+ */
+char *matchOperator(char *s, int *start) {
+    for (int i = 0; operatorTokens[i] != NULL; i++) {
+        int len = strlen(operatorTokens[i]);
+        if (strncmp(s + *start, operatorTokens[i], len) == 0) {
+            *start = *start + len;
+            return operatorTokens[i];
+        }
+    }
+    assert(false); // every operator character is an operator on its own
+    return NULL;
+}
+
+/**
+ * Checks whether the \param len characters at \param s are all digits.
+ * @param s the characters.
+ * @param len the number of characters.
+ * @return a bool denoting whether \param s is a number.
+ */
+bool isNumber(char *s, int len) {
+    for (int i = 0; i < len; i++) {
+        if (!isdigit((unsigned char)s[i])) {
+            return false;
+        }
+    }
+    return len > 0;
+}
+
+/**
+ * The function tokenList reads an array and puts the tokens that are read in a list.
+ * The tokens point into \param s, which is modified in place and must therefore stay
+ * alive as long as the list is used. The list nodes are allocated from \param arena,
+ * so the complete list is released by resetting or freeing the arena. An unquoted number
+ * that is directly followed by "<" or ">" gets flag TOKEN_IO_NUMBER, a token with an
+ * expansion ("$") gets flag TOKEN_EXPAND and one whose quotes were stripped gets flag
+ * TOKEN_QUOTED. An unquoted newline, as in a compound command
+ * that spans several lines, is an operator: it separates chains like ";".
+ * @param s input string.
+ * @param arena the arena that holds the list nodes.
+ * @return a pointer to the beginning of the list.
+ */
+List getTokenList(char *s, Arena *arena) {
+    List lastNode = NULL;
+    List node = NULL;
+    List tl = NULL;
+    char *pendingEnd = NULL; // end of the last identifier that is not yet NUL-terminated
+    int i = 0;
+    int length = strlen(s);
+    while (i < length) {
+        if (pendingEnd != NULL && pendingEnd < s + i) { // the scanner has moved past it
+            *pendingEnd = '\0';
+            pendingEnd = NULL;
+        }
+        if (isspace(s[i]) && s[i] != '\n') { // spaces are skipped
+            i++;
+        }else {
+            node = arenaAlloc(arena, sizeof(*node));
+            node->next = NULL;
+            node->flags = 0;
+            if (isOperatorCharacter(s[i])) {
+                node->t = matchOperator(s, &i);
+            } else {
+                int start = i;
+                bool expand;
+                node->t = matchIdentifier(s, &i, &pendingEnd, &expand);
+                bool unquoted = pendingEnd - node->t == i - start;
+                if ((s[i] == '<' || s[i] == '>') && unquoted && isNumber(node->t, i - start)) {
+                    node->flags = TOKEN_IO_NUMBER;
+                }
+                if (expand) {
+                    node->flags = TOKEN_EXPAND;
+                } else if (!unquoted) {
+                    node->flags = TOKEN_QUOTED;
+                }
+            }
+            if (lastNode == NULL) { // there is no list yet
+                tl = node;
+            } else { // a list already exists; add current node at the end
+                (lastNode)->next = node;
+            }
+            lastNode = node;
+        }
+    }
+    if (pendingEnd != NULL) {
+        *pendingEnd = '\0';
+    }
+    return tl;
+}
+
+/**
+ * Checks whether list \param l is empty.
+ * @param l input list.
+ * @return a bool denoting whether \param l is empty.
+ */
+bool isEmpty(List l) {
+    return l == NULL;
+}
+
+/**
+ * The function printList prints the tokens in a token list, separated by commas.
+ * @param li the input list to be printed.
+ */
+void printList(List li) {
+    if (li == NULL) return;
+    printf("\"%s\"", li->t);
+    li = li->next;
+    while (li != NULL) {
+        printf(", \"%s\"", li->t);
+        li = li->next;
+    }
+    printf("\n");
+}
+
+//function that returns whether exit should be initialized 
+int eofExit(){
+    return initExit;
+}
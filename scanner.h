@@ -1,24 +1,78 @@
 #ifndef SCANNER_H
 #define SCANNER_H
 
-#define INITIAL_STRING_SIZE 10
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/types.h>
+
+#include "arena.h"
+
+#define INPUT_BLOCK_SIZE 65536
+
+// buffered line reader; the buffer is either on the heap or a mapping of a regular file
+typedef struct InputReader {
+    int fd;
+    char *buf;
+    size_t size;        // capacity of buf
+    size_t start;       // start of the input that has not been handed out yet
+    size_t end;         // end of the valid data in buf
+    size_t scan;        // how far the current line has been scanned for a newline
+    bool quoteStarted;  // quote state at scan
+    bool eof;
+    bool mapped;
+    bool seekable;
+    off_t synced;       // file offset set by the last syncInputReader of a mapped reader
+    bool childMayRead;  // a child may have moved the file offset since then
+    char *tail;         // copy of an unterminated last line of a mapped file
+} InputReader;
+
+// flags of a token
+#define TOKEN_IO_NUMBER 1   // a file descriptor number directly before "<" or ">"
+#define TOKEN_EXPAND 2      // contains "$" or a wildcard: kept verbatim, quotes included, for expansion
+#define TOKEN_QUOTED 4      // contained quotes, which were stripped
+
+// the maximum nesting depth of "$(" that the scanner keeps track of quotes for
+#define MAX_SUBSTITUTION_DEPTH 64
 
 typedef struct ListNode *List;
 
 typedef struct ListNode {
     char *t;
+    int flags;
     List next;
 } ListNode;
 
 
+void initInputReader(InputReader *r, int fd);
+
+void initStringReader(InputReader *r, char *s);
+
+bool inputEnded(InputReader *r);
+
+char *readLine(InputReader *r);
+
+char *readRawLine(InputReader *r);
+
+void syncInputReader(InputReader *r);
+
+void closeInputReader(InputReader *r);
+
+InputReader *getStdinReader();
+
 char *readInputLine();
 
-List getTokenList(char *s);
+void syncInput();
+
+size_t substitutionLength(char *s);
+
+bool isExpansion(char *s);
+
+bool hasClosingBracket(char *s);
+
+List getTokenList(char *s, Arena *arena);
 
 bool isEmpty(List l);
 
 void printList(List l);
 
-void freeTokenList(List l);
-
 #endif
\ No newline at end of file
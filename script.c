@@ -0,0 +1,272 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include "scanner.h"
+#include "shell.h"
+#include "script.h"
+#include "hash.h"
+#include "exec.h"
+#include "jobs.h"
+
+/**
+ * Doubles the size of the line cache of script \param sc and rehashes its entries.
+ * @param sc the script.
+ */
+void growCache(Script *sc) {
+    size_t oldSize = sc->cacheSize;
+    ScriptLine **old = sc->cache;
+
+    sc->cacheSize = oldSize == 0 ? INITIAL_CACHE_SIZE : 2 * oldSize;
+    sc->cache = calloc(sc->cacheSize, sizeof(*sc->cache));
+    assert(sc->cache != NULL);
+
+    for (size_t i = 0; i < oldSize; i++) {
+        if (old[i] != NULL) {
+            size_t j = old[i]->hash & (sc->cacheSize - 1);
+            while (sc->cache[j] != NULL) {
+                j = (j + 1) & (sc->cacheSize - 1);
+            }
+            sc->cache[j] = old[i];
+        }
+    }
+    free(old);
+}
+
+/**
+ * Looks up line \param text in the cache of script \param sc. A line that is not in the
+ * cache yet is scanned, parsed and added to it, unless it has here-documents or continues
+ * on the next lines of reader \param r, as a loop may: the text of the line does not
+ * determine the parse tree then.
+ * @param sc the script.
+ * @param text the line.
+ * @param r the reader that the line was read from.
+ * @return the cache entry of the line.
+ */
+ScriptLine *cacheLine(Script *sc, char *text, InputReader *r) {
+    size_t len = strlen(text);
+    unsigned long h = hashString(text, len);
+
+    if (2 * (sc->numCached + 1) > sc->cacheSize) { // keep the load factor below 1/2
+        growCache(sc);
+    }
+
+    size_t i = h & (sc->cacheSize - 1);
+    while (sc->cache[i] != NULL) {
+        ScriptLine *e = sc->cache[i];
+        if (e->hash == h && e->len == len && memcmp(e->text, text, len) == 0) {
+            return e;
+        }
+        i = (i + 1) & (sc->cacheSize - 1);
+    }
+
+    // the scanner rewrites its input, so the tokens get their own copy of the line
+    ScriptLine *e = arenaAlloc(&sc->arena, sizeof(*e));
+    e->text = arenaStrndup(&sc->arena, text, len);
+    e->len = len;
+    e->hash = h;
+    List tokenList = getTokenList(arenaStrndup(&sc->arena, text, len), &sc->arena);
+    LineSource source = {r, readLine};
+    e->valid = parseContinuedLine(&tokenList, &e->line, &source, &sc->arena) && tokenList == NULL;
+    if (e->line.hereDocuments == NULL && !e->line.continued) {
+        sc->cache[i] = e;
+        sc->numCached++;
+    }
+    return e;
+}
+
+/**
+ * Reads and parses the lines of reader \param r until EOF. Every distinct line is
+ * scanned and parsed once.
+ * @param sc the script to fill.
+ * @param r the reader to read the lines from.
+ */
+void readScript(Script *sc, InputReader *r) {
+    size_t capacity = 0;
+    char *line;
+
+    memset(sc, 0, sizeof(*sc));
+    while ((line = readLine(r)) != NULL) {
+        if (sc->numLines == capacity) {
+            capacity = capacity == 0 ? INITIAL_CACHE_SIZE : 2 * capacity;
+            sc->lines = realloc(sc->lines, capacity * sizeof(*sc->lines));
+            assert(sc->lines != NULL);
+        }
+        ScriptLine *e = cacheLine(sc, line, r);
+        if (e->valid && e->line.hereDocuments != NULL) {
+            readHereDocuments(&e->line, r, &sc->arena);
+        }
+        sc->lines[sc->numLines++] = e;
+    }
+}
+
+/**
+ * Reads and parses the script in file \param path.
+ * @param sc the script to fill.
+ * @param path the path of the script file.
+ * @return a bool denoting whether the script could be read.
+ */
+bool loadScript(Script *sc, char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    InputReader reader;
+    initInputReader(&reader, fd);
+    readScript(sc, &reader);
+    closeInputReader(&reader);
+    close(fd);
+    return true;
+}
+
+/**
+ * Executes the lines of script \param sc in order, from their cached parse trees. The
+ * shell exits after the last line, so the program of its final command replaces the
+ * shell.
+ * @param sc the script.
+ */
+void runScript(Script *sc) {
+    for (size_t i = 0; i < sc->numLines; i++) {
+        notifyJobs();
+        if (!sc->lines[i]->valid) {
+            printf("Error: invalid syntax!\n");
+            exit(1);
+        }
+        lastInProcess = i == sc->numLines - 1;
+        runInputLine(&sc->lines[i]->line);
+    }
+    lastInProcess = false;
+}
+
+/**
+ * Checks that every line of script \param sc was parsed successfully.
+ * @param sc the script.
+ * @return a bool denoting whether the script is free of syntax errors.
+ */
+bool validScript(Script *sc) {
+    for (size_t i = 0; i < sc->numLines; i++) {
+        if (!sc->lines[i]->valid) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Finds the running line that process \param pid executes.
+ * @param running the processes of the running lines.
+ * @param maxJobs size of \param running.
+ * @param pid the process.
+ * @return the index in \param running, or -1 when \param pid does not run a line.
+ */
+int findRunningLine(pid_t *running, int maxJobs, pid_t pid) {
+    for (int i = 0; i < maxJobs; i++) {
+        if (running[i] == pid) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/**
+ * Executes the lines of script \param sc as independent commands, with at most
+ * \param maxJobs of them running at the same time. Every line runs in a forked copy of
+ * the shell; whenever one of them terminates, the next line is started. The exit codes
+ * are stored in input order in lastStatuses.
+ * @param sc the script.
+ * @param maxJobs maximum number of lines that run at the same time.
+ * @return 0 when every line succeeded, otherwise the exit code of the first line (in
+ * input order) that failed.
+ */
+int runScriptParallel(Script *sc, int maxJobs) {
+    pid_t *running = malloc(maxJobs * sizeof(*running));  // the process of each slot
+    size_t *lineOf = malloc(maxJobs * sizeof(*lineOf));    // the line that each slot runs
+    assert(running != NULL && lineOf != NULL);
+    for (int i = 0; i < maxJobs; i++) {
+        running[i] = -1;
+    }
+
+    setLastStatuses(sc->numLines);
+    size_t next = 0;
+    int numRunning = 0;
+
+    while (next < sc->numLines || numRunning > 0) {
+        // fill the free slots
+        while (next < sc->numLines && numRunning < maxJobs) {
+            int slot = findRunningLine(running, maxJobs, -1);
+
+            fflush(stdout);
+            syncInput();
+            pid_t pid = fork();
+            if (pid == -1) {
+                printf("Error in fork\n");
+                lastStatuses[next++] = 1;
+                continue;
+            }
+            if (pid == 0) {
+                lastInProcess = true;
+                runInputLine(&sc->lines[next]->line);
+                exit(last);
+            }
+            running[slot] = pid;
+            lineOf[slot] = next++;
+            numRunning++;
+        }
+        if (numRunning == 0) {
+            break;
+        }
+
+        // sleep until any child terminates
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            // ECHILD: the running lines were reaped elsewhere, so their exit codes are lost
+            for (int i = 0; i < maxJobs; i++) {
+                if (running[i] != -1) {
+                    lastStatuses[lineOf[i]] = 1;
+                    running[i] = -1;
+                }
+            }
+            numRunning = 0;
+            continue;
+        }
+        int slot = findRunningLine(running, maxJobs, pid);
+        if (slot == -1) {
+            recordChildExit(pid, status);  // a background job
+            continue;
+        }
+        lastStatuses[lineOf[slot]] = WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+        running[slot] = -1;
+        numRunning--;
+    }
+    free(running);
+    free(lineOf);
+
+    for (int i = 0; i < numLastStatuses; i++) {
+        if (lastStatuses[i] != 0) {
+            return lastStatuses[i];
+        }
+    }
+    return 0;
+}
+
+/**
+ * Releases the memory held by script \param sc.
+ * @param sc the script.
+ */
+void freeScript(Script *sc) {
+    arenaFree(&sc->arena);
+    free(sc->lines);
+    free(sc->cache);
+}
@@ -0,0 +1,42 @@
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "scanner.h"
+#include "shell.h"
+
+#define INITIAL_CACHE_SIZE 64
+
+// a distinct line of a script, scanned and parsed once
+typedef struct ScriptLine {
+    char *text;             // the line as it appears in the script
+    size_t len;
+    unsigned long hash;
+    InputLine line;         // the parse tree of the line
+    bool valid;             // whether the line was parsed successfully
+} ScriptLine;
+
+typedef struct Script {
+    Arena arena;            // holds the cached lines, their tokens and parse trees
+    ScriptLine **lines;     // the lines of the script in order; equal lines share an entry
+    size_t numLines;
+    ScriptLine **cache;     // open addressing hash table of the distinct lines
+    size_t cacheSize;
+    size_t numCached;
+} Script;
+
+void readScript(Script *sc, InputReader *r);
+
+bool loadScript(Script *sc, char *path);
+
+bool validScript(Script *sc);
+
+void runScript(Script *sc);
+
+int runScriptParallel(Script *sc, int maxJobs);
+
+void freeScript(Script *sc);
+
+#endif
@@ -1,82 +1,22 @@
+#include <assert.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <stdbool.h>
 #include <string.h>
-#include <unistd.h>
-#include <sys/types.h>
-#include <sys/wait.h>
-#include <fcntl.h>
 
 #include "scanner.h"
 #include "shell.h"
+#include "variables.h"
 
-// array to store command options
-char **optionsList;
+// where the parser links the next "<<" of the inputline
+static Redirection **hereDocumentTail;
 
-// variable for the exit code of the last command executed
-int last = 0;
-
-// variable to keep track of the last parsed operator
-char *lastOp = "";
-char *currOp = "";
-bool containsPipes= false;
-// variable that is 1 when the last command executed was the special command status
-//int last_command_status = 0;
-
-char *inpF = "";
-char *outF = "";
-bool isInput = false;
-bool isOutput = false;
-int numPipes = 0;
-
-// structure to store pipes command and options
-
-struct Pipe
-{
-    char **cmds;
-    struct Pipe *next;
-};
-
-struct Pipe *front = NULL;
-struct Pipe *rear = NULL;
-
-
-//function to add and store pipes and commands to LL
-void enqueue(char *args[], int size){
-
-    struct Pipe *newNode = malloc(sizeof(struct Pipe));
-    newNode->cmds = (char **)malloc(size * sizeof(char *));
-
-    for (int i = 0; i < size; i++){
-        (newNode->cmds)[i] = args[i];
-    }
-
-    newNode->next = NULL;
-    if (front == NULL){
-        // queue is empty, set front and rear to new element
-        front = newNode;
-        rear = newNode;
-    }else{
-        // add new element to end of queue
-        rear->next = newNode;
-        rear = newNode;
-    }
-}
-
-void freePipes(){
-    // printf("trying to free pipes :(\n");
-    struct Pipe *current = front;
-
-    while (current != NULL){
-        struct Pipe *next = current->next;
-        free(current->cmds);
-        free(current);
-        current = next;
-    }
-    front = NULL;
-    rear = NULL;
-}
+// the inputline that is being parsed, and where it continues; NULL when it cannot
+static InputLine *parsedLine;
+static LineSource *lineSource;
 
+// compound commands contain chains themselves
+bool parseChainList(List *lp, Chain **chainp, bool nested, Arena *arena);
 
 /**
  * The function acceptToken checks whether the current token matches a target identifier,
@@ -94,33 +34,46 @@ bool acceptToken(List *lp, char *ident){
     return false;
 }
 
-//determines whether or not to execute next command 
-int executeNextCommand(){
-    if ((strcmp(lastOp, "&&") == 0) && (last != 0)){
-        return 1;
-    }else if ((strcmp(lastOp, "||") == 0) && (last == 0)){
-        return 1;
-    }else{
-        return 0;
+/**
+ * Continues the inputline that is being parsed on the next line of the input once all of
+ * its tokens have been used: token list \param lp is set to a newline followed by the
+ * tokens of that line. The bodies of the here-documents of the lines before are read
+ * first, since they come before it in the input.
+ * @param lp List pointer to the start of the tokenlist.
+ * @param arena the arena that holds the tokens and the parse tree.
+ */
+void continueInput(List *lp, Arena *arena){
+    if (!isEmpty(*lp) || lineSource == NULL){
+        return;
     }
+    readHereDocuments(parsedLine, lineSource->reader, arena);
+    char *text = lineSource->nextLine(lineSource->reader);
+    if (text == NULL){  // the input ends in the middle of the inputline
+        lineSource = NULL;
+        return;
+    }
+
+    List newline = arenaAlloc(arena, sizeof(*newline));
+    newline->t = "\n";
+    newline->flags = 0;
+    newline->next = getTokenList(arenaStrndup(arena, text, strlen(text)), arena);
+    *lp = newline;
+    parsedLine->continued = true;
 }
 
 /**
- * The function parseExecutable parses an executable.
+ * Skips the newlines at the start of token list \param lp, as well as the lines that the
+ * inputline continues on if \param more holds, until a token is found.
  * @param lp List pointer to the start of the tokenlist.
- * @return a bool denoting whether the executable was parsed successfully.
+ * @param more whether the inputline has to continue when its tokens run out.
+ * @param arena the arena that holds the tokens and the parse tree.
  */
-bool parseExecutable(List *lp){
-
-    //dynamically allocate memory for optionsList and store first pointer at first index 
-    optionsList = (char **)malloc(2 * sizeof(char *));
-   
-    int i= 0;
-
-    optionsList[i] = (*lp)->t;
-    (*lp) = (*lp)->next;    // increment pointer 
-
-    return true;
+void skipNewlines(List *lp, bool more, Arena *arena){
+    do {
+        if (more){
+            continueInput(lp, arena);
+        }
+    } while (acceptToken(lp, "\n"));
 }
 
 /**
@@ -139,12 +92,19 @@ bool isOperator(char *s){
         "<",
         ">",
         "|",
+        "|&",
+        "<<<",
+        "<<",
+        "<&",
+        ">>",
+        ">&",
+        "(",
+        ")",
+        "\n",
         NULL};
 
     for (int i = 0; operators[i] != NULL; i++){
         if (strcmp(s, operators[i]) == 0){
-            currOp = operators[i];
-
             return true;
         }
     }
@@ -152,457 +112,649 @@ bool isOperator(char *s){
 }
 
 /**
- * The function parseOptions parses options.
+ * The function parseExecutable parses an executable.
  * @param lp List pointer to the start of the tokenlist.
- * @return a bool denoting whether the options were parsed successfully.
+ * @param executable set to the name of the executable.
+ * @return a bool denoting whether the executable was parsed successfully.
  */
-bool parseOptions(List *lp){
+bool parseExecutable(List *lp, char **executable){
 
-    int i = 1;
-    int opListSize = 2; //current optionsList size 
+    if (isEmpty(*lp) || isOperator((*lp)->t))return false;
 
+    *executable = (*lp)->t;
+    (*lp) = (*lp)->next;    // increment pointer
 
-    //storing each (*lp)->t as an option, if any exist
-    while (*lp != NULL && !isOperator((*lp)->t)){
+    return true;
+}
 
-        //reallocating memory to expand optionsList if needed
-        if (i >= opListSize - 1){
-            optionsList = realloc(optionsList, 2 * opListSize * sizeof(char *));
-            opListSize = 2 * opListSize;
-        }
+/**
+ * Checks whether a redirection starts at token list \param l: a redirection operator,
+ * possibly preceded by a file descriptor number.
+ * @param l the token list.
+ * @return a bool denoting whether \param l starts with a redirection.
+ */
+bool isRedirection(List l){
+    char *operators[] = {"<", ">", ">>", "<&", ">&", "<<<", "<<", NULL};
 
-        optionsList[i] = (*lp)->t;
-        (*lp) = (*lp)->next;
-        i++;
+    if (l == NULL) return false;
+    if (l->flags & TOKEN_IO_NUMBER) return true;
+    for (int i = 0; operators[i] != NULL; i++){
+        if (strcmp(l->t, operators[i]) == 0){
+            return true;
+        }
     }
-    optionsList[i] = NULL;
-    opListSize = i + 1;
+    return false;
+}
 
-    //pipe logic 
-    if (strcmp(currOp, "|") == 0 || containsPipes){
-        containsPipes = true;
-        numPipes++;
+/**
+ * Skips the redirection at the start of token list \param l, without checking it.
+ * @param l the token list, for which isRedirection holds.
+ * @return the token list after the redirection.
+ */
+List skipRedirection(List l){
+    if (l->flags & TOKEN_IO_NUMBER) l = l->next;    // the operator follows
+    l = l->next;
+    return l != NULL ? l->next : NULL;
+}
 
-        //add to LL 
-        enqueue(optionsList, opListSize);
-    }
-    currOp = "";
+/**
+ * The function parseFileName parses a filename.
+ * @param lp List pointer to the start of the tokenlist.
+ * @param fileName set to the parsed filename.
+ * @return a bool denoting whether the filename was parsed successfully.
+ */
+bool parseFileName(List *lp, char **fileName){
 
-    //built-ins logic 
+    if (isEmpty(*lp) || isOperator((*lp)->t))return false;
 
-    //to exit shell
-    if (strcmp(optionsList[0], "exit") == 0){
-        if (!executeNextCommand()){
-            free(optionsList);
-            _exit(0);   //child processes to use 
-        }
-        lastOp = "";
-        free(optionsList);
-    
+    *fileName = (*lp)->t;
 
-    // print most recent status 
-    }else if (strcmp(optionsList[0], "status") == 0){
+    //inc pointer
+    *lp = (*lp)->next;
+    return true;
+}
 
-        if (!executeNextCommand() || (last == 127)){
-            //last_command_status = 1;
-            printf("The most recent exit code is: %d\n", last);
-        }
-        lastOp = "";
-        free(optionsList);
+/**
+ * Converts \param s to one of the file descriptors that can be redirected: 0, 1 or 2.
+ * @param s the string.
+ * @param fd set to the file descriptor.
+ * @return a bool denoting whether \param s is such a file descriptor.
+ */
+bool parseDescriptor(char *s, int *fd){
+    if (s[0] < '0' || s[0] > '2' || s[1] != '\0'){
+        return false;
+    }
+    *fd = s[0] - '0';
+    return true;
+}
 
+/**
+ * The function parseRedirection parses a redirection according to the grammar:
+ *
+ * <redirection>        ::= <fd> "<" <filename>
+ *                       |  <fd> ">" <filename>
+ *                       |  <fd> ">>" <filename>
+ *                       |  <fd> "<&" <fd-number>
+ *                       |  <fd> ">&" <fd-number>
+ *                       |  <fd> "<<<" <word>
+ *                       |  <fd> "<<" <delimiter>
+ *
+ * <fd>                 ::= <fd-number> | <empty>
+ *
+ * where <fd-number> is 0, 1 or 2. Without <fd>, the operators that start with "<"
+ * redirect stdin and the others stdout. The body of a here-document is read later, by
+ * readHereDocuments.
+ * @param lp List pointer to the start of the tokenlist.
+ * @param rp where the redirection has to be stored.
+ * @param arena the arena that holds the parse tree.
+ * @return a bool denoting whether the redirection was parsed successfully.
+ */
+bool parseRedirection(List *lp, Redirection **rp, Arena *arena){
+    char *operators[] = {"<", ">", ">>", "<&", ">&", "<<<", "<<", NULL};
+    RedirectionType types[] = {REDIRECT_INPUT, REDIRECT_OUTPUT, REDIRECT_APPEND, REDIRECT_DUPLICATE,
+                               REDIRECT_DUPLICATE, REDIRECT_STRING, REDIRECT_HEREDOC};
+    Redirection *r = arenaAlloc(arena, sizeof(*r));
+    int fd = -1;
+
+    if (((*lp)->flags & TOKEN_IO_NUMBER) && !parseDescriptor((*lp)->t, &fd)){
+        return false;
+    }
+    if ((*lp)->flags & TOKEN_IO_NUMBER){
+        *lp = (*lp)->next;
+    }
 
-    //check input for directory given for cd 
-    }else if (strcmp(optionsList[0], "cd") == 0){
+    int i = 0;
+    while (operators[i] != NULL && !acceptToken(lp, operators[i])){
+        i++;
+    }
+    if (operators[i] == NULL || isEmpty(*lp)){
+        return false;
+    }
+    if (types[i] == REDIRECT_HEREDOC){  // delimiters are literal; a quoted one keeps the body literal too
+        r->expand = !((*lp)->flags & TOKEN_QUOTED);
+    }else{
+        r->expand = (*lp)->flags & TOKEN_EXPAND;
+    }
+    if (!parseFileName(lp, &r->word)){
+        return false;
+    }
+    r->type = types[i];
+    r->fd = fd != -1 ? fd : operators[i][0] == '<' ? 0 : 1;
+    r->body = NULL;
+    r->bodyLength = 0;
+    r->next = NULL;
+    r->nextHereDocument = NULL;
+
+    if (r->type == REDIRECT_DUPLICATE && !parseDescriptor(r->word, &r->sourceFd)){
+        return false;
+    }
+    if (r->type == REDIRECT_STRING && !r->expand){    // the input is the word and a newline
+        r->bodyLength = strlen(r->word) + 1;
+        r->body = arenaAlloc(arena, r->bodyLength);
+        memcpy(r->body, r->word, r->bodyLength - 1);
+        r->body[r->bodyLength - 1] = '\n';
+    }
+    if (r->type == REDIRECT_HEREDOC){
+        *hereDocumentTail = r;
+        hereDocumentTail = &r->nextHereDocument;
+    }
+    *rp = r;
+    return true;
+}
 
-        if (executeNextCommand() == 0){
+/**
+ * Records that word \param i of command \param cmd contains a command substitution.
+ * @param cmd the command, of which argc is known.
+ * @param i the index of the word.
+ * @param arena the arena that holds the parse tree.
+ */
+void markExpansion(Command *cmd, int i, Arena *arena){
+    if (cmd->expand == NULL){
+        cmd->expand = arenaAlloc(arena, cmd->argc * sizeof(*cmd->expand));
+        memset(cmd->expand, 0, cmd->argc * sizeof(*cmd->expand));
+    }
+    cmd->expand[i] = true;
+}
 
-            if(optionsList[1] == NULL){
-                printf("Error: cd requires folder to navigate to!\n");
-                last= 2;        // exit 2 for cd errors 
+/**
+ * The function parseOptions parses options and redirections, which may be mixed. The
+ * options are stored together with the executable in the argument list of command
+ * \param cmd, the redirections in its list of redirections.
+ * @param lp List pointer to the start of the tokenlist.
+ * @param cmd the command that the options belong to.
+ * @param executable the name of the executable, which becomes argv[0].
+ * @param arena the arena that holds the parse tree.
+ * @return a bool denoting whether the options were parsed successfully.
+ */
+bool parseOptions(List *lp, Command *cmd, char *executable, Arena *arena){
+
+    // count the options first, so that the argument list is allocated only once
+    int numOptions = 0;
+    List l = *lp;
+    while (l != NULL && (isRedirection(l) || !isOperator(l->t))){
+        if (isRedirection(l)){
+            l = skipRedirection(l);
+        }else{
+            numOptions++;
+            l = l->next;
+        }
+    }
 
-            } else {
+    cmd->argc = numOptions + 1;
+    cmd->argv = arenaAlloc(arena, (cmd->argc + 1) * sizeof(char *));
+    cmd->argv[0] = executable;
+    cmd->expand = NULL;
+    cmd->redirections = NULL;
 
-            // check directory exists 
-                if(chdir(optionsList[1]) == -1){
-                    printf("Error: cd directory not found!\n");
-                    last= 2;
-    
-                }
-                last= 0;
+    //storing each (*lp)->t as an option, if any exist
+    Redirection **tail = &cmd->redirections;
+    int i = 1;
+    while (*lp != NULL && (isRedirection(*lp) || !isOperator((*lp)->t))){
+        if (isRedirection(*lp)){
+            if (!parseRedirection(lp, tail, arena)){
+                return false;
+            }
+            tail = &(*tail)->next;
+        }else{
+            if ((*lp)->flags & TOKEN_EXPAND){
+                markExpansion(cmd, i, arena);
             }
+            cmd->argv[i++] = (*lp)->t;
+            (*lp) = (*lp)->next;
         }
-        lastOp = "";
-        free(optionsList);
-    }
-    if (containsPipes){
-        free(optionsList);
     }
+    cmd->argv[cmd->argc] = NULL;
+    cmd->words = cmd->argv;
+    cmd->numWords = cmd->argc;
 
     return true;
 }
 
 /**
- * The function parseRedirections parses a command according to the grammar:
- *
- * <command>        ::= <executable> <options>
- *
- * @param lp List pointer to the start of the tokenlist.
- * @return a bool denoting whether the command was parsed successfully.
+ * Finds the utility builtin named \param name, which the shell runs instead of the
+ * executable with that name.
+ * @param name the name of the executable.
+ * @return the builtin, or NULL when \param name is not a utility builtin.
  */
-bool parseCommand(List *lp){
-    return parseExecutable(lp) && parseOptions(lp);
+BuiltIn *findUtility(char *name){
+
+    for (int i = 0; builtIns[i].name != NULL; i++){
+        if (builtIns[i].utility && strcmp(name, builtIns[i].name) == 0){
+            return &builtIns[i];
+        }
+    }
+    return NULL;
 }
 
 /**
- * The function parsePipeline parses a pipeline according to the grammar:
+ * The function parseCommand parses a command according to the grammar:
  *
- * <pipeline>           ::= <command> "|" <pipeline>
- *                       | <command>
+ * <command>        ::= <assignments> <executable> <options>
+ *                   |  <assignment> <assignments>
  *
+ * <assignments>    ::= <assignment> <assignments>
+ *                   |  <empty>
+ *
+ * where <options> may contain <redirection>s, which are applied in order. The assignments
+ * before an executable only apply to its environment; without an executable, they set
+ * shell variables.
  * @param lp List pointer to the start of the tokenlist.
- * @return a bool denoting whether the pipeline was parsed successfully.
+ * @param cmd the command to fill.
+ * @param arena the arena that holds the parse tree.
+ * @return a bool denoting whether the command was parsed successfully.
  */
-bool parsePipeline(List *lp){
+bool parseCommand(List *lp, Command *cmd, Arena *arena){
+    char *executable;
+    Assignment **tail = &cmd->assignments;
+
+    cmd->assignments = NULL;
+    while (*lp != NULL && isAssignment((*lp)->t)){
+        Assignment *a = arenaAlloc(arena, sizeof(*a));
+        a->word = (*lp)->t;
+        a->expand = ((*lp)->flags & TOKEN_EXPAND) != 0;
+        a->next = NULL;
+        *tail = a;
+        tail = &a->next;
+        *lp = (*lp)->next;
+    }
+    if (cmd->assignments != NULL && (isEmpty(*lp) || isOperator((*lp)->t))){
+        cmd->argv = arenaAlloc(arena, sizeof(char *));
+        cmd->argv[0] = NULL;
+        cmd->argc = 0;
+        cmd->words = cmd->argv;
+        cmd->numWords = 0;
+        cmd->expand = NULL;
+        cmd->redirections = NULL;
+        return true;
+    }
 
-    if (!parseCommand(lp)){
+    bool expand = *lp != NULL && ((*lp)->flags & TOKEN_EXPAND);
+
+    if (!parseExecutable(lp, &executable)){
         return false;
     }
-
-    if (acceptToken(lp, "|")){
-        return parsePipeline(lp);
+    cmd->builtIn = expand ? NULL : findUtility(executable);
+    if (!parseOptions(lp, cmd, executable, arena)){
+        return false;
+    }
+    if (expand){    // the executable is only known once it has been expanded
+        markExpansion(cmd, 0, arena);
     }
-
     return true;
 }
 
 /**
- * The function parseFileName parses a filename.
+ * The function parseRelay parses a relay: "|&" followed by a filename and the redirections
+ * of the relay. The relay copies the output of the command before it into the file and
+ * passes it on unchanged, to the next command or to where its own stdout is redirected.
  * @param lp List pointer to the start of the tokenlist.
- * @return a bool denoting whether the filename was parsed successfully.
+ * @param chain the chain that the relay belongs to.
+ * @param cmdp where the relay has to be stored.
+ * @param arena the arena that holds the parse tree.
+ * @return a bool denoting whether the relay was parsed successfully.
  */
-bool parseFileName(List *lp){
-
-    if (isEmpty(*lp) || isOperator((*lp)->t))return false;
-    
-    // save file name and assign to input/output file depending on redirection symbol
-    char *fileName = (*lp)->t;
-
-    if (strcmp(lastOp, "<") == 0){
-        inpF = fileName;
-    }else if (strcmp(lastOp, ">") == 0){
-        outF = fileName;
+bool parseRelay(List *lp, Chain *chain, Command **cmdp, Arena *arena){
+
+    Command *relay = arenaAlloc(arena, sizeof(*relay));
+    relay->argv = NULL;
+    relay->argc = 0;
+    relay->words = NULL;
+    relay->numWords = 0;
+    relay->expand = NULL;
+    relay->assignments = NULL;
+    relay->builtIn = NULL;
+    relay->compound = NULL;
+    relay->redirections = NULL;
+    relay->next = NULL;
+
+    if (!parseFileName(lp, &relay->relayFile)){
+        return false;
     }
 
-    //inc pointer
-    *lp = (*lp)->next;
+    Redirection **tail = &relay->redirections;
+    while (isRedirection(*lp)){
+        if (!parseRedirection(lp, tail, arena)){
+            return false;
+        }
+        tail = &(*tail)->next;
+    }
+    *cmdp = relay;
+    chain->numCommands++;
     return true;
 }
 
+/**
+ * Moves the redirections of stdin from a file from command \param from to the end of the
+ * redirections of command \param to.
+ * @param from the command to take the redirections from.
+ * @param to the command to give the redirections to.
+ */
+void moveInputRedirections(Command *from, Command *to){
+    Redirection **tail = &to->redirections;
+    while (*tail != NULL){
+        tail = &(*tail)->next;
+    }
 
-bool checkRedirections(List *lp){
-    
-    if (acceptToken(lp, "<")){
-            fflush(stdout);
-            lastOp = "<";
-
+    Redirection **rp = &from->redirections;
+    while (*rp != NULL){
+        Redirection *r = *rp;
+        if (r->type == REDIRECT_INPUT && r->fd == 0){
+            *rp = r->next;
+            r->next = NULL;
+            *tail = r;
+            tail = &r->next;
+        }else{
+            rp = &r->next;
+        }
+    }
+}
 
-            if (parseFileName(lp)){
-                isInput= true;
-            }else{
-                freePipes();
-                return false;
-            }
+/**
+ * Checks whether a compound command starts at token list \param l.
+ * @param l the token list.
+ * @return a bool denoting whether \param l starts with "{", "(", "if", "while", "until"
+ * or "for".
+ */
+bool startsCompound(List l){
+    char *keywords[] = {"{", "(", "if", "while", "until", "for", NULL};
 
-            if (acceptToken(lp, ">")){
-                lastOp = ">";
+    for (int i = 0; l != NULL && keywords[i] != NULL; i++){
+        if (strcmp(l->t, keywords[i]) == 0){
+            return true;
+        }
+    }
+    return false;
+}
 
+/**
+ * Checks whether token list \param l is at a word that ends a list of chains inside a
+ * compound command, such as "}", "then" or "done". These only end a list where a command
+ * would start, so "echo done" prints "done".
+ * @param l the token list.
+ * @return a bool denoting whether the list ends.
+ */
+bool endsList(List l){
+    char *keywords[] = {"}", ")", "then", "elif", "else", "fi", "do", "done", NULL};
 
-                if (parseFileName(lp)){
-                    isOutput = true;
-                }else {
-                    freePipes();
-                    return false;
-                }
-            }
+    for (int i = 0; l != NULL && keywords[i] != NULL; i++){
+        if (strcmp(l->t, keywords[i]) == 0){
+            return true;
         }
-        else if (acceptToken(lp, ">")){
-            lastOp = ">";
+    }
+    return false;
+}
 
-            if (parseFileName(lp)){
-                isOutput= true;
-            }else {
-                freePipes();
-                return false;
-            }
-        
-            if (acceptToken(lp, "<")){
-                //lastOp = "<";
-                
-                if (parseFileName(lp)){
-                    lastOp= "<";
-                    isInput = true;
-                }else{
-                    freePipes();
-                    return false;
-                }
-            }
-        }
-    return true;
+/**
+ * Parses the list of a compound command, which must not be empty, up to the keyword that
+ * ends it. The list may continue on the next lines of the input.
+ * @param lp List pointer to the start of the tokenlist.
+ * @param chainp where the first chain of the list has to be stored.
+ * @param arena the arena that holds the parse tree.
+ * @return a bool denoting whether the list was parsed successfully.
+ */
+bool parseList(List *lp, Chain **chainp, Arena *arena){
+    *chainp = NULL;
+    return parseChainList(lp, chainp, true, arena) && *chainp != NULL;
 }
 
 /**
- * The function parseRedirections parses redirections according to the grammar:
+ * The function parseIf parses the rest of an if after "if" or "elif" according to the
+ * grammar:
+ *
+ * <if>                 ::= <list> "then" <list> <else> "fi"
  *
- * <redirections>       ::= <pipeline> <redirections>
- *                       |  <builtin> <options>
+ * <else>               ::= "elif" <if>
+ *                       |  "else" <list>
+ *                       |  <empty>
  *
+ * An "elif" becomes an if of its own, which ends at the same "fi".
  * @param lp List pointer to the start of the tokenlist.
- * @return a bool denoting whether the redirections were parsed successfully.
+ * @param compound the if to fill.
+ * @param arena the arena that holds the parse tree.
+ * @return a bool denoting whether the if was parsed successfully.
  */
-bool parseRedirections(List *lp){
-
-    if (containsPipes){
-
-       checkRedirections(lp);
-
-        int pipefd[2];  //fd[0] for input (read end), fd[1] for output (write end)
-        pid_t pid;
-        int status;
-        int openIn, openOut;
-        struct Pipe *curr = front;
-
-        int prev_read = 0;
-
-        for (int i = 0; i < numPipes; i++){
-            // Create a pipe for inter-process communication
-            pipe(pipefd);
-
-            // Fork a child process
-            pid = fork();
-
-            if (pid == 0){ // Child process{
-                if (isInput){
-                    openIn = open(inpF, O_RDONLY);  //pgm using input file's data so read only 
-
-                    if(openIn == 0){
-                        close(0);       // deallocates input fd 
-                        dup(openIn);
-                        close(openIn);
-                        //isInput= false;
-
-                    } else if (openIn == -1){
-                        printf("Error opening input file\n");
-                        return false;
-                    }
-                }
-                
-                if (isOutput){
-                    openOut = open(outF, O_CREAT| O_TRUNC| O_WRONLY, 0644); // create file if it doesn't exits, truncate if it does
-                    
-                    if(openOut == 0){
-                        close(1);       //deallocates output fd
-                        dup(openOut);
-                        close(openOut);
-                        //isOutput= false;
-
-                    }else if (openOut == -1){
-                        printf("Error opening output file\n");
-                        return false;
-                    }
-                }
-
-
-                // Redirect stdin to read end of previous pipe
-                if (i != 0){
-                    dup2(prev_read, STDIN_FILENO);
-                    close(prev_read);
-                }
-
-                // Redirect stdout to write end of current pipe
-                if (i != numPipes - 1){
-                    dup2(pipefd[1], STDOUT_FILENO);
-                    close(pipefd[1]);
-                }
-
-                // Execute the command
-                execvp(curr->cmds[0], curr->cmds);
-
-                // If execvp returns, there was an error
-            }else if (pid < 0){
-                printf("Error in fork\n"); 
-                last= 1;
-                exit(1);
-            }
-
-            // Parent process
-            curr = curr->next;
-            close(pipefd[1]);
-            prev_read = pipefd[0];
-        }
+bool parseIf(List *lp, Compound *compound, Arena *arena){
+    compound->type = COMPOUND_IF;
+    if (!parseList(lp, &compound->condition, arena) || !acceptToken(lp, "then") ||
+        !parseList(lp, &compound->body, arena)){
+        return false;
+    }
+    if (acceptToken(lp, "elif")){
+        compound->elseIf = arenaAlloc(arena, sizeof(*compound->elseIf));
+        memset(compound->elseIf, 0, sizeof(*compound->elseIf));
+        return parseIf(lp, compound->elseIf, arena);
+    }
+    if (acceptToken(lp, "else") && !parseList(lp, &compound->elseBody, arena)){
+        return false;
+    }
+    return acceptToken(lp, "fi");
+}
 
-        
-        //waiting for all child processes to finish
-        for (int i = 0; i < numPipes; i++){
+/**
+ * Parses the rest of a while or until loop after its keyword: <list> "do" <list> "done".
+ * @param lp List pointer to the start of the tokenlist.
+ * @param compound the loop to fill.
+ * @param arena the arena that holds the parse tree.
+ * @return a bool denoting whether the loop was parsed successfully.
+ */
+bool parseLoop(List *lp, Compound *compound, Arena *arena){
+    return parseList(lp, &compound->condition, arena) && acceptToken(lp, "do") &&
+           parseList(lp, &compound->body, arena) && acceptToken(lp, "done");
+}
 
-            waitpid(-1, &status, 0);
-            //last_command_status = 0;
+/**
+ * The function parseFor parses the rest of a for loop after "for" according to the
+ * grammar:
+ *
+ * <for>                ::= <name> "in" <words> <separator> "do" <list> "done"
+ *
+ * where <separator> is ";" or a newline. The words are expanded when the loop starts.
+ * @param lp List pointer to the start of the tokenlist.
+ * @param compound the loop to fill.
+ * @param arena the arena that holds the parse tree.
+ * @return a bool denoting whether the loop was parsed successfully.
+ */
+bool parseFor(List *lp, Compound *compound, Arena *arena){
+    compound->type = COMPOUND_FOR;
+    if (isEmpty(*lp) || variableNameLength((*lp)->t) != strlen((*lp)->t) ||
+        ((*lp)->flags & TOKEN_EXPAND)){
+        return false;
+    }
+    compound->variable = (*lp)->t;
+    *lp = (*lp)->next;
+    if (!acceptToken(lp, "in")){
+        return false;
+    }
 
-            // check if child process ended normally 
-            if (WIFEXITED(status)){
-                last = WEXITSTATUS(status); // if so, save child process' exit code 
+    List l = *lp;
+    while (l != NULL && !isOperator(l->t)){
+        compound->numWords++;
+        l = l->next;
+    }
+    compound->words = arenaAlloc(arena, (compound->numWords + 1) * sizeof(char *));
+    for (int i = 0; i < compound->numWords; i++){
+        if ((*lp)->flags & TOKEN_EXPAND){
+            if (compound->expand == NULL){
+                compound->expand = arenaAlloc(arena, compound->numWords * sizeof(bool));
+                memset(compound->expand, 0, compound->numWords * sizeof(bool));
             }
+            compound->expand[i] = true;
         }
-
-        freePipes();
-        return true;
+        compound->words[i] = (*lp)->t;
+        *lp = (*lp)->next;
     }
+    compound->words[compound->numWords] = NULL;
 
-    if (isEmpty(*lp) || ((strcmp((*lp)->t, "<") != 0) && (strcmp((*lp)->t, ">") != 0)))
-    {
-
-        if (executeNextCommand() != 1){
-
-            pid_t pid = fork();
-
-            if (pid == -1)
-            {
-                // Handle error.
-                printf("error in fork");
-            }
-            else if (pid == 0)
-            {
-                // We are in the child process.
-
-                fflush(stdout);
-
-                // check if the command should be executed
-                if (executeNextCommand() == 1){
-                    lastOp = "";
-                    free(optionsList);
-                    _exit(0);
-                }else{
-                    // Use execvp() to execute the command in the child process.
-
-                    execvp(optionsList[0], optionsList);
-                    // If execvp() succeeds, this code will not be reached.
-                    printf("Error: command not found!\n");
-                    _exit(127);
-                }
-            }
-            else
-            {
-                // We are in the parent process.
-                // Use waitpid() to wait for the child process to complete.
-
-                int status;
-                waitpid(pid, &status, 0);
-                //last_command_status = 0;
+    acceptToken(lp, ";");
+    skipNewlines(lp, true, arena);
+    return acceptToken(lp, "do") && parseList(lp, &compound->body, arena) && acceptToken(lp, "done");
+}
 
-                if (WIFEXITED(status))
-                {
-                    // save exit code of the child process
+/**
+ * The function parseCompound parses a compound command according to the grammar:
+ *
+ * <compound>           ::= "{" <list> "}" <redirections>
+ *                       |  "(" <list> ")" <redirections>
+ *                       |  "if" <if> <redirections>
+ *                       |  "while" <list> "do" <list> "done" <redirections>
+ *                       |  "until" <list> "do" <list> "done" <redirections>
+ *                       |  "for" <for> <redirections>
+ *
+ * where <list> is a non-empty <inputline> that may span several lines. Like any command
+ * before a keyword on the same line, its last one has to be terminated by ";" or "&". The
+ * command gets a label as its only word, which is what the jobs builtin and the trace show
+ * of it.
+ * @param lp List pointer to the start of the tokenlist.
+ * @param cmd the command to fill.
+ * @param arena the arena that holds the parse tree.
+ * @return a bool denoting whether the compound command was parsed successfully.
+ */
+bool parseCompound(List *lp, Command *cmd, Arena *arena){
+    Compound *compound = arenaAlloc(arena, sizeof(*compound));
+    char *label;
+    bool parsed;
+
+    memset(compound, 0, sizeof(*compound));
+    if (acceptToken(lp, "(")){
+        compound->type = COMPOUND_SUBSHELL;
+        label = "( ... )";
+        parsed = parseList(lp, &compound->body, arena) && acceptToken(lp, ")");
+    }else if (acceptToken(lp, "{")){
+        compound->type = COMPOUND_GROUP;
+        label = "{ ...; }";
+        parsed = parseList(lp, &compound->body, arena) && acceptToken(lp, "}");
+    }else if (acceptToken(lp, "if")){
+        label = "if ...; fi";
+        parsed = parseIf(lp, compound, arena);
+    }else if (acceptToken(lp, "while")){
+        compound->type = COMPOUND_WHILE;
+        label = "while ...; done";
+        parsed = parseLoop(lp, compound, arena);
+    }else if (acceptToken(lp, "until")){
+        compound->type = COMPOUND_UNTIL;
+        label = "until ...; done";
+        parsed = parseLoop(lp, compound, arena);
+    }else if (acceptToken(lp, "for")){
+        label = "for ...; done";
+        parsed = parseFor(lp, compound, arena);
+    }else{
+        return false;
+    }
+    if (!parsed){
+        return false;
+    }
 
-                    last = WEXITSTATUS(status);
-                }
-            }
+    cmd->compound = compound;
+    cmd->argv = arenaAlloc(arena, 2 * sizeof(char *));
+    cmd->argv[0] = label;
+    cmd->argv[1] = NULL;
+    cmd->argc = 1;
+    cmd->words = cmd->argv;
+    cmd->numWords = 1;
+    cmd->expand = NULL;
+    cmd->assignments = NULL;
+    cmd->redirections = NULL;
+
+    Redirection **tail = &cmd->redirections;
+    while (isRedirection(*lp)){
+        if (!parseRedirection(lp, tail, arena)){
+            return false;
         }
-
-        lastOp = "";
-        free(optionsList);
-
-        return true;
+        tail = &(*tail)->next;
     }
+    return true;
+}
 
-    isInput = false;
-    isOutput = false;
-
-    checkRedirections(lp); 
-
-    pid_t pid = fork();
-    if (pid == 0){
-        
-        //check if input and output files are the same 
-        if (isInput && isOutput && (strcmp(inpF, outF) == 0)){
-            printf("Error: input and output files cannot be equal!\n");
-            _exit(2);
-        }
-        
-        if (isInput){
-            int openIn = open(inpF, O_RDONLY); // pgm taking input from file so read only 
-            
-            if (openIn < 0){
-                printf("Error in open\n");
-                return false;
-            
-            } else {
-                close(0);
-                dup(openIn);        //redirect input
-                close(openIn);
-        
-            }
+/**
+ * The function parsePipeline parses a pipeline according to the grammar:
+ *
+ * <pipeline>           ::= <stage> "|" <pipeline>
+ *                       | <stage> "|&" <filename> "|" <pipeline>
+ *                       | <stage> "|&" <filename> <redirections>
+ *                       | <stage>
+ *
+ * <stage>              ::= <command> | <compound>
+ *
+ * The pipeline is parsed with a loop instead of recursion, so the depth of the stack does
+ * not depend on the number of commands. As before redirections were per command, an input
+ * file after the last command of a pipeline is the input of the first command.
+ * @param lp List pointer to the start of the tokenlist.
+ * @param chain the chain that the pipeline belongs to.
+ * @param cmdp where the first command of the pipeline has to be stored.
+ * @param arena the arena that holds the parse tree.
+ * @return a bool denoting whether the pipeline was parsed successfully.
+ */
+bool parsePipeline(List *lp, Chain *chain, Command **cmdp, Arena *arena){
+    Command *first = NULL;
+    Command *last = NULL;
+    bool piped;
+
+    do {
+        Command *cmd = arenaAlloc(arena, sizeof(*cmd));
+        cmd->builtIn = NULL;
+        cmd->relayFile = NULL;
+        cmd->compound = NULL;
+        cmd->next = NULL;
+
+        if (!(startsCompound(*lp) ? parseCompound(lp, cmd, arena) : parseCommand(lp, cmd, arena))){
+            return false;
         }
+        *cmdp = cmd;
+        chain->numCommands++;
+        if (first == NULL) first = cmd;
+        last = cmd;
 
-        if (isOutput){
-            int openOut = open(outF, O_CREAT| O_TRUNC| O_WRONLY, 0644); // create file if it doesn't exist, truncate if it does 
-            if (openOut < 0){
-                printf("Error in open\n");
+        if (acceptToken(lp, "|&")){
+            if (!parseRelay(lp, chain, &cmd->next, arena)){
                 return false;
-
-            }else{
-                close(1);
-                dup(openOut);   // redirect output
-                close(openOut);
             }
+            cmd = cmd->next;
         }
-
-        // child process running user command 
-        if(execvp(optionsList[0], optionsList) < 0){
-
-            //upon execvp failure 
-            printf("Error: command not found!\n");
-            last= 127;
-            _exit(127);
+        cmdp = &cmd->next;  // the next command is linked after this one
+        piped = acceptToken(lp, "|");
+        if (piped){     // the next command may be on the next line
+            skipNewlines(lp, true, arena);
         }
+    } while (piped);
 
-
-    }else{
-
-        //wait for child processes to exit 
-        int status;
-        waitpid(pid, &status, 0);
-        //last_command_status = 0;
-
-        //determine if child processes exit natrually
-        // if so, save child process' exit code
-        if (WIFEXITED(status)) last = WEXITSTATUS(status); 
-
+    if (last != first){
+        moveInputRedirections(last, first);
     }
-    free(optionsList);
     return true;
 }
 
 /**
- * The function parseBuiltIn parses a builtin.
+ * The function parseBuiltIn parses a builtin that changes the shell itself, such as cd.
+ * Utility builtins such as echo are parsed as ordinary commands instead.
  * @param lp List pointer to the start of the tokenlist.
+ * @param builtIn set to the builtin that was parsed.
  * @return a bool denoting whether the builtin was parsed successfully.
  */
-bool parseBuiltIn(List *lp){
+bool parseBuiltIn(List *lp, BuiltIn **builtIn){
 
-    // NULL-terminated array makes it easy to expand this array later
-    // without changing the code at other places.
-    char *builtIns[] = {
-        "exit",
-        "status",
-        "cd",
-        NULL
-        };
-
-    for (int i = 0; builtIns[i] != NULL; i++){
-        if (acceptToken(lp, builtIns[i])){
-
-            //dynamically allocate memory for optionsList
-            optionsList = (char **)malloc(2 * sizeof(char *));
-            optionsList[0] = builtIns[i];
+    for (int i = 0; builtIns[i].name != NULL; i++){
+        if (!builtIns[i].utility && acceptToken(lp, builtIns[i].name)){
+            *builtIn = &builtIns[i];
             return true;
         }
     }
@@ -612,27 +764,60 @@ bool parseBuiltIn(List *lp){
 /**
  * The function parseChain parses a chain according to the grammar:
  *
- * <chain>              ::= <pipeline> <redirections>
- *                       |  <builtin> <options>
+ * <chain>              ::= <timing> <pipeline>
+ *                       |  <timing> <builtin> <options>
+ *
+ * <timing>             ::= "time"
+ *                       |  <empty>
  *
  * @param lp List pointer to the start of the tokenlist.
+ * @param chain the chain to fill.
+ * @param arena the arena that holds the parse tree.
  * @return a bool denoting whether the chain was parsed successfully.
  */
-bool parseChain(List *lp)
+bool parseChain(List *lp, Chain *chain, Arena *arena)
 {
-
-    if (parseBuiltIn(lp)){
-        return parseOptions(lp);
+    BuiltIn *builtIn;
+
+    chain->commands = NULL;
+    chain->numCommands = 0;
+    chain->op = OP_NONE;
+    chain->timed = acceptToken(lp, "time");
+    chain->next = NULL;
+
+    if (parseBuiltIn(lp, &builtIn)){
+        Command *cmd = arenaAlloc(arena, sizeof(*cmd));
+        cmd->builtIn = builtIn;
+        cmd->assignments = NULL;
+        cmd->relayFile = NULL;
+        cmd->compound = NULL;
+        cmd->next = NULL;
+        chain->commands = cmd;
+        chain->numCommands = 1;
+        return parseOptions(lp, cmd, builtIn->name, arena);
     }
-    
-    if (parsePipeline(lp)){
-        return parseRedirections(lp);
+
+    return parsePipeline(lp, chain, &chain->commands, arena);
+}
+
+/**
+ * Sets the successor that is selected by \param success of the chains in list
+ * \param waiting to \param target. The list is threaded through that same successor
+ * field, which is only overwritten after it has been followed.
+ * @param waiting the first chain of the list.
+ * @param target the successor.
+ * @param success whether onSuccess is set, otherwise onFailure.
+ */
+void linkChains(Chain *waiting, Chain *target, bool success){
+    while (waiting != NULL){
+        Chain **field = success ? &waiting->onSuccess : &waiting->onFailure;
+        waiting = *field;
+        *field = target;
     }
-    return false;
 }
 
 /**
- * The function parseInputLine parses an inputline according to the grammar:
+ * The function parseChainList parses the chains of an inputline according to the grammar:
  *
  * <inputline>      ::= <chain> & <inputline>
  *                   | <chain> && <inputline>
@@ -641,29 +826,144 @@ bool parseChain(List *lp)
  *                   | <chain>
  *                   | <empty>
  *
+ * where ";" may also be a newline. A list inside a compound command (\param nested) ends
+ * before the keyword that ends it, such as "}" or "done", and continues on the next line
+ * of the input until then, as does a list that ends with "&&" or "||". The chains are
+ * parsed with a loop instead of recursion, so that a line with any number of chains is
+ * parsed in linear time and constant stack space. The and-or lists are compiled on the
+ * way: every chain gets the chain that runs after it when it succeeds, the next one after
+ * "&&", and when it fails, the next one after "||".
  * @param lp List pointer to the start of the tokenlist.
+ * @param chainp where the first chain has to be stored.
+ * @param nested whether the list is part of a compound command.
+ * @param arena the arena that holds the parse tree.
+ * @return a bool denoting whether the chains were parsed successfully.
+ */
+bool parseChainList(List *lp, Chain **chainp, bool nested, Arena *arena){
+    ChainOperator op = OP_NONE;     // the operator before the current chain
+    Chain *waitSuccess = NULL;      // the chains of the and-or list that do not have a
+    Chain *waitFailure = NULL;      // successor for that outcome yet
+
+    while (true){
+        skipNewlines(lp, nested || op == OP_AND || op == OP_OR, arena);
+        if (isEmpty(*lp) || endsList(*lp)){
+            break;
+        }
+        Chain *chain = arenaAlloc(arena, sizeof(*chain));
+        if (!parseChain(lp, chain, arena))return false;
+        *chainp = chain;
+
+        if (op == OP_AND){
+            linkChains(waitSuccess, chain, true);
+            waitSuccess = NULL;
+        }else if (op == OP_OR){
+            linkChains(waitFailure, chain, false);
+            waitFailure = NULL;
+        }
+        chain->onSuccess = waitSuccess;
+        chain->onFailure = waitFailure;
+        waitSuccess = waitFailure = chain;
+
+        // save the operator that follows the chain
+        if (nested){
+            continueInput(lp, arena);
+        }
+        if (acceptToken(lp, "&")){
+            chain->op = OP_BACKGROUND;
+        }else if (acceptToken(lp, "&&")){
+            chain->op = OP_AND;
+        }else if (acceptToken(lp, "||")){
+            chain->op = OP_OR;
+        }else if (acceptToken(lp, ";") || acceptToken(lp, "\n")){
+            chain->op = OP_SEQUENCE;
+        }else{
+            break;
+        }
+        op = chain->op;
+        if (op != OP_AND && op != OP_OR){   // the end of the and-or list
+            linkChains(waitSuccess, NULL, true);
+            linkChains(waitFailure, NULL, false);
+            waitSuccess = waitFailure = NULL;
+        }
+        chainp = &chain->next;
+    }
+    linkChains(waitSuccess, NULL, true);
+    linkChains(waitFailure, NULL, false);
+    return true;
+}
+
+/**
+ * The function parseInputLine parses an inputline into a parse tree, without executing
+ * anything. The tree is allocated from \param arena and refers to the strings of the
+ * tokenlist, so it stays valid as long as both are alive.
+ * @param lp List pointer to the start of the tokenlist.
+ * @param line the parse tree to fill.
+ * @param arena the arena that holds the parse tree.
  * @return a bool denoting whether the inputline was parsed successfully.
  */
-bool parseInputLine(List *lp){
+bool parseInputLine(List *lp, InputLine *line, Arena *arena){
+    return parseContinuedLine(lp, line, NULL, arena);
+}
 
-    // pipes and redirections not parsed here
-    containsPipes = false;
-    numPipes = 0;
+/**
+ * Parses an inputline like parseInputLine, but an inputline that is not complete yet,
+ * such as the first line of a loop, continues on the next lines of \param source. Their
+ * tokens are allocated from \param arena as well, and the bodies of the here-documents of
+ * every line but the last are read on the way.
+ * @param lp List pointer to the start of the tokenlist; set to the remaining tokens of
+ * the last line.
+ * @param line the parse tree to fill.
+ * @param source where the inputline continues, or NULL when it cannot.
+ * @param arena the arena that holds the tokens and the parse tree.
+ * @return a bool denoting whether the inputline was parsed successfully.
+ */
+bool parseContinuedLine(List *lp, InputLine *line, LineSource *source, Arena *arena){
+    line->chains = NULL;
+    line->hereDocuments = NULL;
+    line->continued = false;
+    hereDocumentTail = &line->hereDocuments;
+    parsedLine = line;
+    lineSource = source;
+    return parseChainList(lp, &line->chains, false, arena);
+}
 
-    if (isEmpty(*lp))return true;
+/**
+ * Reads the bodies of the here-documents of inputline \param line from \param r that have
+ * not been read yet. Each body consists of the lines up to the line that equals its
+ * delimiter, or up to the end of the input. A body that has to be expanded stays marked
+ * only when it contains a "$".
+ * @param line the parsed inputline.
+ * @param r the reader that the inputline was read from.
+ * @param arena the arena that holds the parse tree.
+ */
+void readHereDocuments(InputLine *line, InputReader *r, Arena *arena){
+    for (Redirection *doc = line->hereDocuments; doc != NULL; doc = doc->nextHereDocument){
+        if (doc->body != NULL){
+            continue;
+        }
+        size_t size = INITIAL_HERE_DOCUMENT_SIZE;
+        size_t length = 0;
+        char *body = malloc(size);
+        assert(body != NULL);
+
+        char *s;
+        while ((s = readRawLine(r)) != NULL && strcmp(s, doc->word) != 0){
+            size_t n = strlen(s);
+            while (length + n + 1 > size){
+                size *= 2;
+                body = realloc(body, size);
+                assert(body != NULL);
+            }
+            memcpy(body + length, s, n);
+            body[length + n] = '\n';
+            length += n + 1;
+        }
 
-    if (!parseChain(lp))return false;
-    
-    // save last operator 
-    if (acceptToken(lp, "&") || acceptToken(lp, "&&")){
-        lastOp = "&&";
-        return parseInputLine(lp);
-    }else if (acceptToken(lp, "||")){
-        lastOp = "||";
-        return parseInputLine(lp);
-    }else if (acceptToken(lp, ";")){
-        lastOp = ";";
-        return parseInputLine(lp);
+        doc->body = arenaAlloc(arena, length + 1);
+        memcpy(doc->body, body, length);
+        doc->body[length] = '\0';
+        doc->bodyLength = length;
+        doc->expand = doc->expand && memchr(doc->body, '$', length) != NULL;
+        free(body);
     }
-
-    return true;
+}
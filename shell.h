@@ -3,6 +3,119 @@
 
 #include <stdbool.h>
 
-bool parseInputLine(List *lp);
+#include "arena.h"
+#include "scanner.h"
+#include "builtins.h"
+
+#define INITIAL_HERE_DOCUMENT_SIZE 1024
+
+typedef enum RedirectionType {
+    REDIRECT_INPUT,         // <
+    REDIRECT_OUTPUT,        // >
+    REDIRECT_APPEND,        // >>
+    REDIRECT_DUPLICATE,     // >& and <&
+    REDIRECT_STRING,        // <<<
+    REDIRECT_HEREDOC        // <<
+} RedirectionType;
+
+// <redirection>: what file descriptor fd of a command refers to
+typedef struct Redirection {
+    RedirectionType type;
+    int fd;                 // 0, 1 or 2
+    char *word;             // the file name, the here-string, the delimiter or the source
+    bool expand;            // whether word contains an expansion; for "<<", whether the body does
+    int sourceFd;           // the descriptor that is duplicated
+    char *body;             // the input of a here-string or here-document
+    size_t bodyLength;
+    struct Redirection *next;
+    struct Redirection *nextHereDocument;   // the next "<<" of the inputline
+} Redirection;
+
+// <assignment>: "NAME=value" before a command
+typedef struct Assignment {
+    char *word;
+    bool expand;            // whether word contains an expansion
+    struct Assignment *next;
+} Assignment;
+
+typedef enum CompoundType {
+    COMPOUND_GROUP,         // { list; }: runs in the shell itself
+    COMPOUND_SUBSHELL,      // ( list ): runs in a copy of the shell
+    COMPOUND_IF,            // if list; then list; [elif list; then list;] [else list;] fi
+    COMPOUND_WHILE,         // while list; do list; done
+    COMPOUND_UNTIL,         // until list; do list; done
+    COMPOUND_FOR            // for name in words; do list; done
+} CompoundType;
+
+// a command that consists of other commands. Its lists are parsed once and run from the
+// parse tree as often as needed; only their words are expanded again every time
+typedef struct Compound {
+    CompoundType type;
+    struct Chain *condition;    // the list that if and while test
+    struct Chain *body;         // the list of a group or loop, or what "then" runs
+    struct Compound *elseIf;    // the "elif" that follows, as an if of its own
+    struct Chain *elseBody;     // what "else" runs
+    char *variable;             // the variable that a for loop assigns
+    char **words;               // the words that it assigns, as parsed
+    int numWords;
+    bool *expand;               // which of those contain expansions, or NULL if none
+} Compound;
+
+// <command>: an executable (or builtin) with its options, a relay ("|&" <filename>), or a
+// compound command with its redirections
+typedef struct Command {
+    char **argv;            // NULL-terminated; argv[0] is the executable. NULL for a relay
+    int argc;
+    char **words;           // the argument list as parsed; argv differs while it is expanded
+    int numWords;
+    bool *expand;           // which words contain expansions, or NULL if none
+    Assignment *assignments;    // the environment of an executable; for the shell without one
+    BuiltIn *builtIn;       // NULL for an executable
+    char *relayFile;        // the file that a relay copies its input to
+    Compound *compound;     // a compound command instead of an executable, or NULL
+    Redirection *redirections;  // in the order in which they have to be applied
+    struct Command *next;   // next command in the pipeline
+} Command;
+
+typedef enum ChainOperator {
+    OP_NONE,
+    OP_AND,         // &&
+    OP_OR,          // ||
+    OP_SEQUENCE,    // ;
+    OP_BACKGROUND   // &
+} ChainOperator;
+
+// <chain>: a pipeline, or a builtin with its options, optionally prefixed with "time"
+typedef struct Chain {
+    Command *commands;
+    int numCommands;
+    ChainOperator op;       // the operator that follows the chain
+    bool timed;             // whether the chain has the "time" prefix
+    struct Chain *next;
+    // the chain to run next when this one succeeds or fails; NULL at the end of the
+    // and-or list. The chains in between are skipped without being looked at
+    struct Chain *onSuccess;
+    struct Chain *onFailure;
+} Chain;
+
+// <inputline>: the parse tree of a complete line
+typedef struct InputLine {
+    Chain *chains;
+    Redirection *hereDocuments;     // their bodies follow the line in the input
+    bool continued;         // whether the line continued on further lines of the input
+} InputLine;
+
+// where an inputline continues when it ends inside a compound command or after "&&", "||"
+// or "|": the parser reads the next lines on demand
+typedef struct LineSource {
+    InputReader *reader;    // the input, which the bodies of here-documents are read from
+    char *(*nextLine)(InputReader *r);  // reads the next line of the input
+} LineSource;
+
+bool parseInputLine(List *lp, InputLine *line, Arena *arena);
+
+bool parseContinuedLine(List *lp, InputLine *line, LineSource *source, Arena *arena);
+
+void readHereDocuments(InputLine *line, InputReader *r, Arena *arena);
 
 #endif
@@ -0,0 +1,197 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "shell.h"
+#include "trace.h"
+
+// the trace file that SHELL_TRACE names, or -1 when commands are not traced
+int traceFd = -1;
+
+/**
+ * Opens the trace file when the environment variable SHELL_TRACE names one. Every command
+ * that the shell waits for then appends one JSON line with its timings to the file.
+ */
+void initTrace() {
+    char *path = getenv("SHELL_TRACE");
+
+    if (path != NULL && *path != '\0') {
+        traceFd = open(path, O_CREAT | O_WRONLY | O_APPEND | O_CLOEXEC, 0644);
+        if (traceFd == -1) {
+            printf("Error: cannot open trace file %s\n", path);
+        }
+    }
+}
+
+/**
+ * Checks whether commands are traced.
+ * @return a bool denoting whether a trace file is open.
+ */
+bool tracing() {
+    return traceFd != -1;
+}
+
+/**
+ * Stores the current time of the monotonic clock in \param ts.
+ * @param ts where the time has to be stored.
+ */
+void markTime(struct timespec *ts) {
+    clock_gettime(CLOCK_MONOTONIC, ts);
+}
+
+/**
+ * Computes the time from \param from to \param to in microseconds.
+ * @param from the earlier time.
+ * @param to the later time.
+ * @return the elapsed time.
+ */
+long elapsedMicros(struct timespec *from, struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) * 1000000L + (to->tv_nsec - from->tv_nsec) / 1000;
+}
+
+/**
+ * Converts time \param tv to microseconds.
+ * @param tv the time.
+ * @return the time in microseconds.
+ */
+long timevalMicros(struct timeval *tv) {
+    return tv->tv_sec * 1000000L + tv->tv_usec;
+}
+
+/**
+ * Writes the text of command \param cmd to \param buf, as a JSON string when \param json
+ * holds. The text is cut off when it does not fit.
+ * @param buf the buffer.
+ * @param size the size of the buffer.
+ * @param cmd the command.
+ * @param json whether quotes, backslashes and control characters have to be escaped.
+ * @return the number of characters written.
+ */
+int formatCommand(char *buf, int size, Command *cmd, bool json) {
+    char *words[] = {"|&", cmd->relayFile, NULL};
+    char **argv = cmd->argv != NULL ? cmd->argv : words;
+    int len = 0;
+
+    for (int i = 0; argv[i] != NULL && len < size - 7; i++) {
+        if (i > 0) {
+            buf[len++] = ' ';
+        }
+        for (char *s = argv[i]; *s != '\0' && len < size - 7; s++) {
+            if (json && (*s == '\"' || *s == '\\')) {
+                buf[len++] = '\\';
+                buf[len++] = *s;
+            } else if (json && (unsigned char)*s < 0x20) {
+                len += sprintf(buf + len, "\\u%04x", *s);
+            } else {
+                buf[len++] = *s;
+            }
+        }
+    }
+    buf[len] = '\0';
+    return len;
+}
+
+/**
+ * Appends the record of stage \param stage of a chain with \param n stages to the trace
+ * file. The record is written with a single write, so that the records of several shells
+ * that share the file do not get mixed up.
+ * @param cmd the command of the stage.
+ * @param t the timings of the stage.
+ * @param status the exit code of the stage.
+ * @param stage the position of the stage in the pipeline, starting at 1.
+ * @param n the number of stages.
+ */
+void traceCommand(Command *cmd, CommandTiming *t, int status, int stage, int n) {
+    char record[TRACE_RECORD_SIZE];
+    char command[TRACE_RECORD_SIZE / 2];
+    struct timespec now;
+
+    clock_gettime(CLOCK_REALTIME, &now);
+    formatCommand(command, sizeof(command), cmd, true);
+    int len = snprintf(record, sizeof(record),
+                       "{\"time\":%ld.%06ld,\"shell\":%d,\"pid\":%d,\"stage\":%d,\"stages\":%d,"
+                       "\"command\":\"%s\",\"status\":%d,\"wall_us\":%ld,\"launch_us\":%ld,"
+                       "\"run_us\":%ld,\"user_us\":%ld,\"sys_us\":%ld,\"maxrss_kb\":%ld}\n",
+                       (long)now.tv_sec, now.tv_nsec / 1000, (int)getpid(), t->pid, stage, n,
+                       command, status, elapsedMicros(&t->launched, &t->exited),
+                       elapsedMicros(&t->launched, &t->execed), elapsedMicros(&t->execed, &t->exited),
+                       timevalMicros(&t->usage.ru_utime), timevalMicros(&t->usage.ru_stime),
+                       t->usage.ru_maxrss);
+    if (len >= (int)sizeof(record)) {
+        len = sizeof(record) - 1;
+        record[len - 1] = '\n';
+    }
+    if (write(traceFd, record, len) != len) {
+        // a full disk must not stop the shell; the record is lost
+    }
+}
+
+/**
+ * Prints a time in seconds, the way the time prefix shows it.
+ * @param label the name of the time.
+ * @param micros the time in microseconds.
+ */
+void printSeconds(char *label, long micros) {
+    fprintf(stderr, "%s %ld.%03lds", label, micros / 1000000, micros / 1000 % 1000);
+}
+
+/**
+ * Reports the timings of the \param n commands of chain \param chain, which have
+ * finished: a chain with the "time" prefix prints them to stderr, and every command is
+ * appended to the trace file when there is one. Commands that could not be started
+ * (pid -1) are left out.
+ * @param chain the chain.
+ * @param timings the timings of the commands, in pipeline order.
+ * @param statuses the exit codes of the commands.
+ * @param n the number of commands.
+ */
+void reportTimings(Chain *chain, CommandTiming *timings, int *statuses, int n) {
+    Command *cmd = chain->commands;
+    struct timespec *first = NULL, *end = NULL;
+    long user = 0, sys = 0, maxRss = 0;
+
+    for (int i = 0; i < n; i++, cmd = cmd->next) {
+        CommandTiming *t = &timings[i];
+        if (t->pid == -1) continue;
+
+        if (traceFd != -1) {
+            traceCommand(cmd, t, statuses[i], i + 1, n);
+        }
+        if (first == NULL || elapsedMicros(&t->launched, first) > 0) first = &t->launched;
+        if (end == NULL || elapsedMicros(end, &t->exited) > 0) end = &t->exited;
+        user += timevalMicros(&t->usage.ru_utime);
+        sys += timevalMicros(&t->usage.ru_stime);
+        if (t->usage.ru_maxrss > maxRss) maxRss = t->usage.ru_maxrss;
+    }
+    if (!chain->timed || first == NULL) {
+        return;
+    }
+
+    printSeconds("real", elapsedMicros(first, end));
+    printSeconds("  user", user);
+    printSeconds("  sys", sys);
+    fprintf(stderr, "  maxrss %ldKB\n", maxRss);
+
+    if (n == 1) {
+        return;
+    }
+    cmd = chain->commands;
+    for (int i = 0; i < n; i++, cmd = cmd->next) {
+        CommandTiming *t = &timings[i];
+        char command[32];
+        if (t->pid == -1) continue;
+
+        formatCommand(command, sizeof(command), cmd, false);
+        fprintf(stderr, "  %d: %-24s", i + 1, command);
+        printSeconds(" real", elapsedMicros(&t->launched, &t->exited));
+        fprintf(stderr, "  exec %ldus", elapsedMicros(&t->launched, &t->execed));
+        printSeconds("  user", timevalMicros(&t->usage.ru_utime));
+        printSeconds("  sys", timevalMicros(&t->usage.ru_stime));
+        fprintf(stderr, "  maxrss %ldKB  status %d\n", t->usage.ru_maxrss, statuses[i]);
+    }
+}
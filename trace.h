@@ -0,0 +1,29 @@
+#ifndef SHELL_TRACE_H
+#define SHELL_TRACE_H
+
+#include <stdbool.h>
+#include <time.h>
+#include <sys/resource.h>
+
+#include "shell.h"
+
+#define TRACE_RECORD_SIZE 4096
+
+// the timestamps and resource usage of one command (or pipeline stage)
+typedef struct CommandTiming {
+    struct timespec launched;   // just before the child was created
+    struct timespec execed;     // when the child was running the executable
+    struct timespec exited;     // when the child was reaped
+    struct rusage usage;        // as reported by wait4
+    int pid;                    // 0 for a builtin
+} CommandTiming;
+
+void initTrace();
+
+bool tracing();
+
+void markTime(struct timespec *ts);
+
+void reportTimings(Chain *chain, CommandTiming *timings, int *statuses, int n);
+
+#endif
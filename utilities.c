@@ -0,0 +1,539 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <stdarg.h>
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#include "utilities.h"
+
+#define INITIAL_OUTPUT_SIZE 256
+
+// the output of a builtin is collected first, so that it is written with a single call
+typedef struct Output {
+    char *buf;
+    size_t len;
+    size_t size;
+} Output;
+
+/**
+ * Makes room for \param n more characters in output \param out.
+ * @param out the output.
+ * @param n the number of characters.
+ */
+void reserveOutput(Output *out, size_t n) {
+    if (out->len + n > out->size) {
+        out->size = out->size == 0 ? INITIAL_OUTPUT_SIZE : out->size;
+        while (out->len + n > out->size) {
+            out->size = 2 * out->size;
+        }
+        out->buf = realloc(out->buf, out->size);
+        assert(out->buf != NULL);
+    }
+}
+
+/**
+ * Appends character \param c to output \param out.
+ * @param out the output.
+ * @param c the character.
+ */
+void putOutput(Output *out, char c) {
+    reserveOutput(out, 1);
+    out->buf[out->len++] = c;
+}
+
+/**
+ * Appends string \param s to output \param out.
+ * @param out the output.
+ * @param s the string.
+ */
+void putOutputString(Output *out, char *s) {
+    size_t n = strlen(s);
+    reserveOutput(out, n);
+    memcpy(out->buf + out->len, s, n);
+    out->len += n;
+}
+
+/**
+ * Appends the text that printf would print for \param format to output \param out.
+ * @param out the output.
+ * @param format the format.
+ */
+void formatOutput(Output *out, char *format, ...) {
+    va_list ap;
+    va_start(ap, format);
+    int n = vsnprintf(NULL, 0, format, ap);
+    va_end(ap);
+
+    reserveOutput(out, n + 1);
+    va_start(ap, format);
+    vsnprintf(out->buf + out->len, n + 1, format, ap);
+    va_end(ap);
+    out->len += n;
+}
+
+/**
+ * Writes output \param out to stdout and releases it. A write error is reported on
+ * stderr, and the output is dropped.
+ * @param out the output.
+ * @param name the name of the builtin, for the error message.
+ * @return a bool denoting whether the output was written.
+ */
+bool flushOutput(Output *out, char *name) {
+    bool written = true;
+
+    if (out->len > 0) {
+        written = fwrite(out->buf, 1, out->len, stdout) == out->len;
+        written = fflush(stdout) == 0 && written && !ferror(stdout);
+    }
+    free(out->buf);
+    if (!written) {
+        fprintf(stderr, "%s: write error: %s\n", name, strerror(errno));
+        clearerr(stdout);
+    }
+    return written;
+}
+
+/**
+ * The builtin true does nothing, successfully.
+ * @param argv the argument list.
+ * @return 0.
+ */
+int builtInTrue(char **argv) {
+    return 0;
+}
+
+/**
+ * The builtin false does nothing, unsuccessfully.
+ * @param argv the argument list.
+ * @return 1.
+ */
+int builtInFalse(char **argv) {
+    return 1;
+}
+
+/**
+ * Appends the character that backslash escape \param s stands for to output \param out.
+ * An octal escape has at most three digits; with \param leadingZero (for %b) they follow
+ * a zero.
+ * @param out the output.
+ * @param s the escape, starting at the backslash.
+ * @param leadingZero whether octal escapes start with \0.
+ * @return the number of characters of the escape.
+ */
+int putEscape(Output *out, char *s, bool leadingZero) {
+    char *escapes = "\\\\a\ab\bf\fn\nr\rt\tv\v\"\"''";
+    int len = 1;
+
+    if (s[1] >= '0' && s[1] <= '7') {
+        int value = 0;
+        if (leadingZero && s[1] == '0') len++;
+        for (int digits = 0; digits < 3 && s[len] >= '0' && s[len] <= '7'; digits++) {
+            value = 8 * value + s[len++] - '0';
+        }
+        putOutput(out, value);
+        return len;
+    }
+    for (int i = 0; s[1] != '\0' && escapes[i] != '\0'; i += 2) {
+        if (s[1] == escapes[i]) {
+            putOutput(out, escapes[i + 1]);
+            return 2;
+        }
+    }
+    putOutput(out, '\\');  // not an escape: the backslash is printed as it is
+    return 1;
+}
+
+/**
+ * The builtin echo prints its arguments, separated by spaces and followed by a newline.
+ * As in coreutils, leading options consist of the letters "n", which leaves out the
+ * newline, "e", which interprets backslash escapes as printf %b does, and "E", which does
+ * not (the default). "\c" ends the output, without the newline.
+ * @param argv the argument list.
+ * @return 0, or 1 when the output cannot be written.
+ */
+int builtInEcho(char **argv) {
+    Output out = {NULL, 0, 0};
+    bool newline = true;
+    bool escapes = false;
+    int i = 1;
+
+    for (; argv[i] != NULL && argv[i][0] == '-' && argv[i][1] != '\0' &&
+           strspn(argv[i] + 1, "neE") == strlen(argv[i] + 1); i++) {
+        for (char *o = argv[i] + 1; *o != '\0'; o++) {
+            if (*o == 'n') {
+                newline = false;
+            } else {
+                escapes = *o == 'e';
+            }
+        }
+    }
+    for (int first = i; argv[i] != NULL; i++) {
+        if (i > first) {
+            putOutput(&out, ' ');
+        }
+        if (!escapes) {
+            putOutputString(&out, argv[i]);
+            continue;
+        }
+        for (char *s = argv[i]; *s != '\0'; s++) {
+            if (s[0] == '\\' && s[1] == 'c') {
+                return flushOutput(&out, "echo") ? 0 : 1;
+            }
+            if (*s == '\\') {
+                s += putEscape(&out, s, true) - 1;
+            } else {
+                putOutput(&out, *s);
+            }
+        }
+    }
+    if (newline) {
+        putOutput(&out, '\n');
+    }
+    return flushOutput(&out, "echo") ? 0 : 1;
+}
+
+/**
+ * Converts argument \param arg of printf to a number. An argument that starts with a
+ * quote stands for the code of the character after it.
+ * @param arg the argument, or NULL when the arguments have run out.
+ * @param value set to the number.
+ * @return a bool denoting whether \param arg is a valid number.
+ */
+bool printfNumber(char *arg, long long *value) {
+    char *end;
+
+    if (arg == NULL || *arg == '\0') {
+        *value = 0;
+        return true;
+    }
+    if (arg[0] == '\'' || arg[0] == '\"') {
+        *value = (unsigned char)arg[1];
+        return true;
+    }
+    *value = strtoll(arg, &end, 0);
+    if (*end != '\0') {
+        printf("printf: %s: invalid number\n", arg);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Converts argument \param arg of a floating-point conversion of printf to a number. An
+ * argument that starts with a quote stands for the code of the character after it.
+ * @param arg the argument, or NULL when the arguments have run out.
+ * @param value set to the number.
+ * @return a bool denoting whether \param arg is a valid number.
+ */
+bool printfDouble(char *arg, double *value) {
+    char *end;
+
+    if (arg == NULL || *arg == '\0') {
+        *value = 0;
+        return true;
+    }
+    if (arg[0] == '\'' || arg[0] == '\"') {
+        *value = (unsigned char)arg[1];
+        return true;
+    }
+    *value = strtod(arg, &end);
+    if (*end != '\0') {
+        printf("printf: %s: invalid number\n", arg);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Returns the next argument of printf from \param args, and advances past it.
+ * @param args the remaining arguments.
+ * @return the argument, or NULL when the arguments have run out.
+ */
+char *nextArgument(char ***args) {
+    char *arg = **args;
+    if (arg != NULL) {
+        (*args)++;
+    }
+    return arg;
+}
+
+/**
+ * Appends the text for one pass over format \param format to output \param out,
+ * consuming the arguments that the conversions need from \param args. A "*" width or
+ * precision is taken from the next argument.
+ * @param out the output.
+ * @param format the format.
+ * @param args the remaining arguments; advanced past the consumed ones.
+ * @return 0 on success, 1 when an argument is invalid, -1 when the format is invalid,
+ * which ends printf.
+ */
+int formatOnce(Output *out, char *format, char ***args) {
+    int status = 0;
+
+    for (char *f = format; *f != '\0'; f++) {
+        if (*f == '\\') {
+            f += putEscape(out, f, false) - 1;
+            continue;
+        }
+        if (*f != '%') {
+            putOutput(out, *f);
+            continue;
+        }
+        if (f[1] == '%') {
+            putOutput(out, '%');
+            f++;
+            continue;
+        }
+
+        // copy the flags, width and precision of the conversion
+        char spec[64];
+        int n = 0;
+        long long value;
+        spec[n++] = *f++;
+        while (*f != '\0' && strchr("-+ #0123456789.*", *f) != NULL && n < 40) {
+            if (*f != '*') {
+                spec[n++] = *f++;
+                continue;
+            }
+            f++;
+            status |= !printfNumber(nextArgument(args), &value);
+            value = value < INT_MIN ? INT_MIN : value > INT_MAX ? INT_MAX : value;
+            if (value < 0 && spec[n - 1] == '.') {  // a negative precision is left out
+                n--;
+            } else {
+                n += sprintf(spec + n, "%d", (int)value);
+            }
+        }
+        if (strchr("diuoxXcsbfFeEgGaA", *f) == NULL || *f == '\0') {
+            printf("printf: %%%.1s: invalid conversion\n", f);
+            return -1;
+        }
+        char *arg = nextArgument(args);
+
+        double number;
+        switch (*f) {
+        case 'd':
+        case 'i':
+            strcpy(spec + n, "lld");
+            status |= !printfNumber(arg, &value);
+            formatOutput(out, spec, value);
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            sprintf(spec + n, "ll%c", *f);
+            status |= !printfNumber(arg, &value);
+            formatOutput(out, spec, (unsigned long long)value);
+            break;
+        case 'c':
+            if (arg != NULL && *arg != '\0') {
+                strcpy(spec + n, "c");
+                formatOutput(out, spec, *arg);
+            }
+            break;
+        case 's':
+            strcpy(spec + n, "s");
+            formatOutput(out, spec, arg != NULL ? arg : "");
+            break;
+        case 'b':
+            for (char *s = arg != NULL ? arg : ""; *s != '\0'; s++) {
+                if (*s == '\\') {
+                    s += putEscape(out, s, true) - 1;
+                } else {
+                    putOutput(out, *s);
+                }
+            }
+            break;
+        default:    // the floating-point conversions
+            sprintf(spec + n, "%c", *f);
+            status |= !printfDouble(arg, &number);
+            formatOutput(out, spec, number);
+            break;
+        }
+    }
+    return status;
+}
+
+/**
+ * The builtin printf prints its arguments according to a format, like printf(1). The
+ * format is used again as long as arguments are left.
+ * @param argv the argument list; argv[1] is the format.
+ * @return 0 on success, 1 when an argument is invalid or the output cannot be written, 2
+ * when the format is missing.
+ */
+int builtInPrintf(char **argv) {
+    if (argv[1] == NULL) {
+        printf("printf: missing format\n");
+        return 2;
+    }
+
+    Output out = {NULL, 0, 0};
+    char **args = argv + 2;
+    int status = 0;
+    do {
+        char **start = args;
+        int result = formatOnce(&out, argv[1], &args);
+        if (result < 0) {     // the rest of the format cannot be interpreted
+            status = 1;
+            break;
+        }
+        status |= result;
+        if (args == start) {  // the format has no conversions
+            break;
+        }
+    } while (*args != NULL);
+
+    return flushOutput(&out, "printf") ? status : 1;
+}
+
+/**
+ * Evaluates unary test \param op on \param arg.
+ * @param op the operator.
+ * @param arg the operand.
+ * @return 0 when the test holds, 1 when it does not, 2 when the operator is unknown.
+ */
+int testUnary(char *op, char *arg) {
+    struct stat st;
+
+    if (op[0] != '-' || op[1] == '\0' || op[2] != '\0') {
+        printf("test: %s: unary operator expected\n", op);
+        return 2;
+    }
+    switch (op[1]) {
+    case 'n': return arg[0] == '\0';
+    case 'z': return arg[0] != '\0';
+    case 'e': return stat(arg, &st) != 0;
+    case 'f': return stat(arg, &st) != 0 || !S_ISREG(st.st_mode);
+    case 'd': return stat(arg, &st) != 0 || !S_ISDIR(st.st_mode);
+    case 'p': return stat(arg, &st) != 0 || !S_ISFIFO(st.st_mode);
+    case 's': return stat(arg, &st) != 0 || st.st_size == 0;
+    case 'h':
+    case 'L': return lstat(arg, &st) != 0 || !S_ISLNK(st.st_mode);
+    case 'r': return access(arg, R_OK) != 0;
+    case 'w': return access(arg, W_OK) != 0;
+    case 'x': return access(arg, X_OK) != 0;
+    }
+    printf("test: %s: unary operator expected\n", op);
+    return 2;
+}
+
+/**
+ * Converts operand \param s of an integer comparison to a number.
+ * @param s the operand.
+ * @param value set to the number.
+ * @return a bool denoting whether \param s is an integer.
+ */
+bool testInteger(char *s, long long *value) {
+    char *end;
+    *value = strtoll(s, &end, 10);
+    if (*s == '\0' || *end != '\0') {
+        printf("test: %s: integer expression expected\n", s);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Checks whether \param op is a binary operator of test.
+ * @param op the string.
+ * @return a bool denoting whether \param op is a binary operator.
+ */
+bool isTestBinary(char *op) {
+    char *operators[] = {"=", "==", "!=", "-eq", "-ne", "-lt", "-le", "-gt", "-ge", NULL};
+
+    for (int i = 0; operators[i] != NULL; i++) {
+        if (strcmp(op, operators[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Evaluates binary test \param op on \param a and \param b.
+ * @param a the left operand.
+ * @param op the operator, for which isTestBinary holds.
+ * @param b the right operand.
+ * @return 0 when the test holds, 1 when it does not, 2 when an operand is invalid.
+ */
+int testBinary(char *a, char *op, char *b) {
+    long long x, y;
+
+    if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) return strcmp(a, b) != 0;
+    if (strcmp(op, "!=") == 0) return strcmp(a, b) == 0;
+
+    if (!testInteger(a, &x) || !testInteger(b, &y)) return 2;
+    if (strcmp(op, "-eq") == 0) return !(x == y);
+    if (strcmp(op, "-ne") == 0) return !(x != y);
+    if (strcmp(op, "-lt") == 0) return !(x < y);
+    if (strcmp(op, "-le") == 0) return !(x <= y);
+    if (strcmp(op, "-gt") == 0) return !(x > y);
+    return !(x >= y);
+}
+
+/**
+ * Negates the result \param r of a test, keeping errors.
+ * @param r the result.
+ * @return the negated result.
+ */
+int negateTest(int r) {
+    return r == 2 ? 2 : !r;
+}
+
+/**
+ * Evaluates the \param n arguments \param args of test, following the rules of POSIX for
+ * up to four arguments.
+ * @param args the arguments.
+ * @param n the number of arguments.
+ * @return 0 when the expression holds, 1 when it does not, 2 on a syntax error.
+ */
+int evaluateTest(char **args, int n) {
+    switch (n) {
+    case 0:
+        return 1;
+    case 1:
+        return args[0][0] == '\0';
+    case 2:
+        if (strcmp(args[0], "!") == 0) return negateTest(evaluateTest(args + 1, 1));
+        return testUnary(args[0], args[1]);
+    case 3:
+        if (isTestBinary(args[1])) return testBinary(args[0], args[1], args[2]);
+        if (strcmp(args[0], "!") == 0) return negateTest(evaluateTest(args + 1, 2));
+        if (strcmp(args[0], "(") == 0 && strcmp(args[2], ")") == 0) return evaluateTest(args + 1, 1);
+        break;
+    case 4:
+        if (strcmp(args[0], "!") == 0) return negateTest(evaluateTest(args + 1, 3));
+        if (strcmp(args[0], "(") == 0 && strcmp(args[3], ")") == 0) return evaluateTest(args + 1, 2);
+        break;
+    }
+    printf("test: too many arguments\n");
+    return 2;
+}
+
+/**
+ * The builtin test (or "[ ... ]") evaluates a condition on strings, integers or files.
+ * @param argv the argument list.
+ * @return 0 when the condition holds, 1 when it does not, 2 on a syntax error.
+ */
+int builtInTest(char **argv) {
+    int argc = 0;
+    while (argv[argc] != NULL) {
+        argc++;
+    }
+
+    if (strcmp(argv[0], "[") == 0) {
+        if (strcmp(argv[argc - 1], "]") != 0) {
+            printf("[: missing ]\n");
+            return 2;
+        }
+        argc--;
+    }
+    return evaluateTest(argv + 1, argc - 1);
+}
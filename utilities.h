@@ -0,0 +1,17 @@
+#ifndef SHELL_UTILITIES_H
+#define SHELL_UTILITIES_H
+
+// builtins that replace common utilities; they behave like ordinary commands, so they can
+// be redirected and used as stages of a pipeline
+
+int builtInTrue(char **argv);
+
+int builtInFalse(char **argv);
+
+int builtInEcho(char **argv);
+
+int builtInPrintf(char **argv);
+
+int builtInTest(char **argv);
+
+#endif
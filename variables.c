@@ -0,0 +1,372 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <ctype.h>
+#include <assert.h>
+#include <unistd.h>
+
+#include "hash.h"
+#include "variables.h"
+
+// open addressing hash table (linear probing) of the shell variables
+Variable *variables = NULL;
+size_t variableTableSize = 0;
+size_t numVariables = 0;
+
+// the environment that was built from the exported variables, and whether a variable has
+// changed since. environ points to it once it has been built
+char **environment = NULL;
+size_t environmentSize = 0;
+bool environmentChanged = false;
+
+// replaced entries that the environment still refers to; freed when it is rebuilt
+char **retired = NULL;
+size_t numRetired = 0;
+size_t retiredSize = 0;
+
+// the positional parameters: $0, the name of the shell or script, followed by the
+// arguments $1, $2, ... They are not copied
+char **positional = NULL;
+int numPositional = 0;
+
+/**
+ * Determines the length of the variable name at the start of string \param s: a letter or
+ * underscore, followed by letters, digits and underscores.
+ * @param s the string.
+ * @return the length of the name, or 0 when \param s does not start with a name.
+ */
+size_t variableNameLength(char *s) {
+    if (!isalpha((unsigned char)s[0]) && s[0] != '_') {
+        return 0;
+    }
+    size_t n = 1;
+    while (isalnum((unsigned char)s[n]) || s[n] == '_') {
+        n++;
+    }
+    return n;
+}
+
+/**
+ * Checks whether word \param word is an assignment: a variable name directly followed
+ * by "=".
+ * @param word the word.
+ * @return a bool denoting whether \param word is an assignment.
+ */
+bool isAssignment(char *word) {
+    size_t n = variableNameLength(word);
+    return n > 0 && word[n] == '=';
+}
+
+/**
+ * Finds the slot of the variable with name \param name in the table: the slot that holds
+ * it, or the empty slot where it belongs.
+ * @param name the name; it does not have to be NUL-terminated.
+ * @param nameLength the length of \param name.
+ * @param hash the hash of \param name.
+ * @return the index of the slot.
+ */
+size_t findVariable(char *name, size_t nameLength, unsigned long hash) {
+    size_t i = hash & (variableTableSize - 1);
+    while (variables[i].entry != NULL &&
+           (variables[i].hash != hash || variables[i].nameLength != nameLength ||
+            memcmp(variables[i].entry, name, nameLength) != 0)) {
+        i = (i + 1) & (variableTableSize - 1);
+    }
+    return i;
+}
+
+/**
+ * Doubles the size of the table and rehashes its variables.
+ */
+void growVariables() {
+    Variable *old = variables;
+    size_t oldSize = variableTableSize;
+
+    variableTableSize = oldSize == 0 ? INITIAL_VARIABLE_TABLE_SIZE : 2 * oldSize;
+    variables = calloc(variableTableSize, sizeof(*variables));
+    assert(variables != NULL);
+
+    for (size_t i = 0; i < oldSize; i++) {
+        if (old[i].entry != NULL) {
+            variables[findVariable(old[i].entry, old[i].nameLength, old[i].hash)] = old[i];
+        }
+    }
+    free(old);
+}
+
+/**
+ * Releases the entry of variable \param v, which is about to be replaced or removed. An
+ * entry that the environment refers to is kept until the environment is rebuilt, so that
+ * environ stays valid meanwhile.
+ * @param v the variable.
+ */
+void retireEntry(Variable *v) {
+    if (!v->published) {
+        free(v->entry);
+        return;
+    }
+    if (numRetired == retiredSize) {
+        retiredSize = retiredSize == 0 ? INITIAL_VARIABLE_TABLE_SIZE : 2 * retiredSize;
+        retired = realloc(retired, retiredSize * sizeof(*retired));
+        assert(retired != NULL);
+    }
+    retired[numRetired++] = v->entry;
+    v->published = false;
+}
+
+/**
+ * Stores entry \param entry, which consists of a name of \param nameLength characters
+ * optionally followed by "=" and the value, in the table.
+ * @param entry the entry; the table takes ownership.
+ * @param nameLength the length of the name.
+ * @param export whether the variable is exported; an exported variable stays exported.
+ */
+void storeVariable(char *entry, size_t nameLength, bool export) {
+    if (2 * (numVariables + 1) > variableTableSize) { // keep the load factor below 1/2
+        growVariables();
+    }
+
+    unsigned long hash = hashString(entry, nameLength);
+    Variable *v = &variables[findVariable(entry, nameLength, hash)];
+    if (v->entry == NULL) {
+        v->nameLength = nameLength;
+        v->hash = hash;
+        v->exported = false;
+        v->published = false;
+        numVariables++;
+    } else {
+        retireEntry(v);
+    }
+    v->entry = entry;
+    v->exported = v->exported || export;
+    if (v->exported) {
+        environmentChanged = true;
+    }
+}
+
+/**
+ * Fills the table with the environment of the shell, as exported variables. Variables
+ * can be used before this is called: the table is then initialised on first use.
+ */
+void initVariables() {
+    if (variableTableSize != 0) {
+        return;
+    }
+    growVariables();
+    for (char **e = environ; *e != NULL; e++) {
+        char *eq = strchr(*e, '=');
+        if (eq != NULL) {
+            storeVariable(strdup(*e), eq - *e, true);
+        }
+    }
+    environmentChanged = false;    // environ has exactly these entries
+}
+
+/**
+ * Looks up the value of the variable with name \param name.
+ * @param name the name; it does not have to be NUL-terminated.
+ * @param nameLength the length of \param name.
+ * @return the value, or NULL when the variable is not set. The value is owned by the table
+ * and stays valid until the variable is changed.
+ */
+char *getVariable(char *name, size_t nameLength) {
+    initVariables();
+
+    Variable *v = &variables[findVariable(name, nameLength, hashString(name, nameLength))];
+    if (v->entry == NULL || v->entry[nameLength] != '=') {
+        return NULL;
+    }
+    return v->entry + nameLength + 1;
+}
+
+/**
+ * Sets a variable from assignment \param entry, "NAME=value".
+ * @param entry the assignment; it is copied.
+ * @param export whether the variable becomes exported.
+ * @return a bool denoting whether \param entry is a valid assignment.
+ */
+bool setVariable(char *entry, bool export) {
+    size_t n = variableNameLength(entry);
+
+    if (n == 0 || entry[n] != '=') {
+        return false;
+    }
+    initVariables();
+    storeVariable(strdup(entry), n, export);
+    return true;
+}
+
+/**
+ * Exports the variable with name \param name. A variable that is not set yet is added to
+ * the environment as soon as it gets a value.
+ * @param name the name.
+ */
+void exportVariable(char *name) {
+    size_t n = strlen(name);
+
+    initVariables();
+    Variable *v = &variables[findVariable(name, n, hashString(name, n))];
+    if (v->entry == NULL) {
+        storeVariable(strdup(name), n, true);
+    } else if (!v->exported) {
+        v->exported = true;
+        environmentChanged = true;
+    }
+}
+
+/**
+ * Removes the variable with name \param name. The variables after it are moved back so
+ * that probing still finds them.
+ * @param name the name.
+ */
+void unsetVariable(char *name) {
+    size_t n = strlen(name);
+
+    initVariables();
+    size_t i = findVariable(name, n, hashString(name, n));
+    if (variables[i].entry == NULL) {
+        return;
+    }
+    if (variables[i].exported) {
+        environmentChanged = true;
+    }
+    retireEntry(&variables[i]);
+    variables[i].entry = NULL;
+    numVariables--;
+
+    size_t j = i;
+    while (true) {
+        j = (j + 1) & (variableTableSize - 1);
+        if (variables[j].entry == NULL) {
+            break;
+        }
+        size_t home = variables[j].hash & (variableTableSize - 1);
+        // move the variable into the hole unless its home slot lies cyclically in (i, j]
+        if ((j > i && (home <= i || home > j)) || (j < i && (home <= i && home > j))) {
+            variables[i] = variables[j];
+            variables[j].entry = NULL;
+            i = j;
+        }
+    }
+}
+
+/**
+ * Returns the environment of the shell: the exported variables that have a value. The
+ * array is only rebuilt when an exported variable has changed since the last call, and
+ * environ is set to it, so that it is passed on by exec and posix_spawn.
+ * @return the environment.
+ */
+char **shellEnvironment() {
+    initVariables();
+    if (!environmentChanged) {
+        return environ;
+    }
+
+    size_t n = 0;
+    for (size_t i = 0; i < variableTableSize; i++) {
+        Variable *v = &variables[i];
+        if (v->entry != NULL && v->exported && v->entry[v->nameLength] == '=') {
+            n++;
+        }
+    }
+    if (n + 1 > environmentSize) {
+        environmentSize = 2 * (n + 1);
+        free(environment);
+        environment = malloc(environmentSize * sizeof(*environment));
+        assert(environment != NULL);
+    }
+
+    n = 0;
+    for (size_t i = 0; i < variableTableSize; i++) {
+        Variable *v = &variables[i];
+        if (v->entry != NULL && v->exported && v->entry[v->nameLength] == '=') {
+            environment[n++] = v->entry;
+            v->published = true;
+        }
+    }
+    environment[n] = NULL;
+
+    // nothing refers to the entries that were replaced any more
+    for (size_t i = 0; i < numRetired; i++) {
+        free(retired[i]);
+    }
+    numRetired = 0;
+
+    environ = environment;
+    environmentChanged = false;
+    return environment;
+}
+
+/**
+ * Builds the environment of a single command: the environment of the shell with the
+ * assignments \param entries added, or replacing the entries with the same name.
+ * @param entries the assignments, "NAME=value".
+ * @param n the number of assignments.
+ * @return the environment; the caller has to free the array, but not its strings.
+ */
+char **environmentWith(char **entries, int n) {
+    char **base = shellEnvironment();
+    size_t count = 0;
+    while (base[count] != NULL) {
+        count++;
+    }
+
+    char **env = malloc((count + n + 1) * sizeof(*env));
+    assert(env != NULL);
+    memcpy(env, base, count * sizeof(*env));
+
+    for (int i = 0; i < n; i++) {
+        size_t nameLength = strchr(entries[i], '=') - entries[i];
+        size_t j = 0;
+        while (j < count && (strncmp(env[j], entries[i], nameLength) != 0 || env[j][nameLength] != '=')) {
+            j++;
+        }
+        env[j] = entries[i];
+        if (j == count) {
+            count++;
+        }
+    }
+    env[count] = NULL;
+    return env;
+}
+
+/**
+ * Prints the exported variables, the way the export builtin shows them.
+ */
+void printExported() {
+    initVariables();
+    for (size_t i = 0; i < variableTableSize; i++) {
+        if (variables[i].entry != NULL && variables[i].exported) {
+            printf("export %s\n", variables[i].entry);
+        }
+    }
+}
+
+/**
+ * Sets the positional parameters to the \param n strings \param params, which are not
+ * copied: $0 followed by the arguments.
+ * @param params the parameters.
+ * @param n the number of parameters, at least 1.
+ */
+void setPositional(char **params, int n) {
+    positional = params;
+    numPositional = n;
+}
+
+/**
+ * Returns positional parameter \param i, where 0 is the name of the shell or script.
+ * @param i the number of the parameter.
+ * @return the parameter, or NULL when it is not set.
+ */
+char *getPositional(int i) {
+    return i < numPositional ? positional[i] : NULL;
+}
+
+/**
+ * Returns the number of arguments, "$#": the positional parameters without $0.
+ * @return the number of arguments.
+ */
+int numArguments() {
+    return numPositional > 0 ? numPositional - 1 : 0;
+}
@@ -0,0 +1,45 @@
+#ifndef SHELL_VARIABLES_H
+#define SHELL_VARIABLES_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define INITIAL_VARIABLE_TABLE_SIZE 64
+
+// a shell variable. The name and value are stored together as "NAME=value", so that an
+// exported variable can be put in the environment as it is
+typedef struct Variable {
+    char *entry;            // NULL for an empty slot; just "NAME" for an exported variable without value
+    size_t nameLength;
+    unsigned long hash;
+    bool exported;
+    bool published;         // entry is referenced by the environment that was built last
+} Variable;
+
+void initVariables();
+
+bool isAssignment(char *word);
+
+size_t variableNameLength(char *s);
+
+char *getVariable(char *name, size_t nameLength);
+
+bool setVariable(char *entry, bool export);
+
+void exportVariable(char *name);
+
+void unsetVariable(char *name);
+
+char **shellEnvironment();
+
+char **environmentWith(char **entries, int n);
+
+void printExported();
+
+void setPositional(char **params, int n);
+
+char *getPositional(int i);
+
+int numArguments();
+
+#endif
@@ -0,0 +1,289 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <fnmatch.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+#include "wildcard.h"
+
+// a record that getdents64 returns
+typedef struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+} LinuxDirent64;
+
+// what matchWildcards is doing
+typedef struct WildcardSearch {
+    DirectoryCache *cache;
+    WildcardMatch onMatch;
+    void *arg;
+    char *path;         // the path that is being built
+    size_t pathSize;
+    int matches;
+} WildcardSearch;
+
+// the names of the listing that is being sorted, for compareNames
+static char *sortedNames;
+
+/**
+ * Checks whether character \param c is a wildcard: "*", "?" or "[".
+ * @param c the character.
+ * @return a bool denoting whether \param c is a wildcard.
+ */
+bool isWildcard(char c) {
+    return c == '*' || c == '?' || c == '[';
+}
+
+/**
+ * Checks whether pattern \param s contains a wildcard that is not escaped by a backslash.
+ * @param s the pattern.
+ * @param n the number of characters of \param s to check.
+ * @return a bool denoting whether \param s is a pattern.
+ */
+bool isPattern(char *s, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (s[i] == '\\') {
+            i++;
+        } else if (isWildcard(s[i])) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Removes the backslashes that escape characters from string \param s, in place.
+ * @param s the string.
+ */
+void unescapeWord(char *s) {
+    char *out = s;
+
+    for (; *s != '\0'; s++) {
+        if (*s == '\\' && s[1] != '\0') {
+            s++;
+        }
+        *out++ = *s;
+    }
+    *out = '\0';
+}
+
+/**
+ * Compares two names of the listing that is being sorted, for qsort.
+ * @param a the offset of the first name.
+ * @param b the offset of the second name.
+ * @return the order of the names.
+ */
+int compareNames(const void *a, const void *b) {
+    return strcmp(sortedNames + *(const size_t *)a, sortedNames + *(const size_t *)b);
+}
+
+/**
+ * Reads the entries of directory \param path with getdents64 into listing \param l and
+ * sorts them. All names are appended to one buffer and sorted through an array of
+ * offsets, so the number of allocations does not depend on the number of entries. "."
+ * and ".." are left out. A directory that cannot be read has no entries.
+ * @param path the directory.
+ * @param l the listing to fill.
+ */
+void readListing(char *path, DirectoryListing *l) {
+    size_t namesSize = INITIAL_LISTING_SIZE, namesLength = 0, offsetsSize = INITIAL_LISTING_SIZE / 16;
+
+    l->path = strdup(path);
+    l->names = malloc(namesSize);
+    l->offsets = malloc(offsetsSize * sizeof(*l->offsets));
+    l->count = 0;
+    assert(l->path != NULL && l->names != NULL && l->offsets != NULL);
+
+    int fd = open(path, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd == -1) {
+        return;
+    }
+    char *buf = malloc(DIRENT_BUFFER_SIZE);
+    assert(buf != NULL);
+
+    long n;
+    while ((n = syscall(SYS_getdents64, fd, buf, DIRENT_BUFFER_SIZE)) > 0) {
+        for (long pos = 0; pos < n; ) {
+            LinuxDirent64 *d = (LinuxDirent64 *)(buf + pos);
+            pos += d->d_reclen;
+            if (strcmp(d->d_name, ".") == 0 || strcmp(d->d_name, "..") == 0) {
+                continue;
+            }
+
+            size_t len = strlen(d->d_name);
+            while (namesLength + len + 2 > namesSize) {
+                namesSize *= 2;
+                l->names = realloc(l->names, namesSize);
+                assert(l->names != NULL);
+            }
+            if (l->count == offsetsSize) {
+                offsetsSize *= 2;
+                l->offsets = realloc(l->offsets, offsetsSize * sizeof(*l->offsets));
+                assert(l->offsets != NULL);
+            }
+            l->names[namesLength] = d->d_type;
+            memcpy(l->names + namesLength + 1, d->d_name, len + 1);
+            l->offsets[l->count++] = namesLength + 1;
+            namesLength += len + 2;
+        }
+    }
+    free(buf);
+    close(fd);
+
+    sortedNames = l->names;
+    qsort(l->offsets, l->count, sizeof(*l->offsets), compareNames);
+}
+
+/**
+ * Looks up the listing of directory \param path from cache \param cache, reading the
+ * directory when it has not been listed yet.
+ * @param cache the cache.
+ * @param path the directory.
+ * @return the index of the listing in the cache. It is returned instead of a pointer
+ * because the listings move when the cache grows.
+ */
+int getListing(DirectoryCache *cache, char *path) {
+    for (int i = 0; i < cache->numListings; i++) {
+        if (strcmp(cache->listings[i].path, path) == 0) {
+            return i;
+        }
+    }
+
+    if (cache->numListings == cache->listingsSize) {
+        cache->listingsSize = cache->listingsSize == 0 ? 4 : 2 * cache->listingsSize;
+        cache->listings = realloc(cache->listings, cache->listingsSize * sizeof(*cache->listings));
+        assert(cache->listings != NULL);
+    }
+    readListing(path, &cache->listings[cache->numListings]);
+    return cache->numListings++;
+}
+
+/**
+ * Makes room for a path of \param n characters in search \param s.
+ * @param s the search.
+ * @param n the number of characters, including the NUL.
+ */
+void reservePath(WildcardSearch *s, size_t n) {
+    if (n > s->pathSize) {
+        s->pathSize = 2 * n;
+        s->path = realloc(s->path, s->pathSize);
+        assert(s->path != NULL);
+    }
+}
+
+/**
+ * Matches the components of pattern \param rest in the directory whose path, ending with
+ * "/" unless it is empty, occupies the first \param length characters of the path of
+ * search \param s. Components without wildcards are taken as they are; the others are
+ * matched against the listing of the directory, in sorted order.
+ * @param s the search.
+ * @param length the length of the path of the directory.
+ * @param rest the remaining components.
+ */
+void matchComponents(WildcardSearch *s, size_t length, char *rest) {
+    while (*rest == '/') {  // an absolute path, or several slashes
+        reservePath(s, length + 2);
+        s->path[length++] = '/';
+        rest++;
+    }
+    reservePath(s, length + 1);
+    s->path[length] = '\0';
+    if (*rest == '\0') {
+        s->onMatch(s->path, s->arg);
+        s->matches++;
+        return;
+    }
+
+    char *slash = strchr(rest, '/');
+    size_t n = slash != NULL ? (size_t)(slash - rest) : strlen(rest);
+    char *component = strndup(rest, n);
+    assert(component != NULL);
+
+    if (!isPattern(component, n)) {
+        unescapeWord(component);
+        size_t len = strlen(component);
+        reservePath(s, length + len + 1);
+        memcpy(s->path + length, component, len + 1);
+
+        struct stat st;
+        if (slash != NULL) {
+            matchComponents(s, length + len, slash);
+        } else if (lstat(s->path, &st) == 0) {
+            s->onMatch(s->path, s->arg);
+            s->matches++;
+        }
+        free(component);
+        return;
+    }
+
+    // the recursion may list further directories, so the listing is looked up every time
+    int index = getListing(s->cache, length == 0 ? "." : s->path);
+    for (size_t i = 0; i < s->cache->listings[index].count; i++) {
+        DirectoryListing *l = &s->cache->listings[index];
+        char *name = l->names + l->offsets[i];
+        if (fnmatch(component, name, FNM_PERIOD) != 0) {
+            continue;
+        }
+
+        size_t len = strlen(name);
+        reservePath(s, length + len + 1);
+        memcpy(s->path + length, name, len + 1);
+        if (slash == NULL) {
+            s->onMatch(s->path, s->arg);
+            s->matches++;
+            continue;
+        }
+
+        unsigned char type = name[-1];
+        struct stat st;
+        if (type == DT_DIR || ((type == DT_LNK || type == DT_UNKNOWN) && stat(s->path, &st) == 0 &&
+                               S_ISDIR(st.st_mode))) {
+            matchComponents(s, length + len, slash);
+        }
+    }
+    free(component);
+}
+
+/**
+ * Finds the paths that match pattern \param pattern, in which "*", "?" and "[...]" are
+ * wildcards unless they are escaped by a backslash. Names that start with "." are only
+ * matched by a pattern that starts with "." as well. Directories are listed with
+ * getdents64, at most once per cache.
+ * @param pattern the pattern.
+ * @param cache the directories that were listed before.
+ * @param onMatch called with every matching path, in sorted order.
+ * @param arg passed on to \param onMatch.
+ * @return the number of matches.
+ */
+int matchWildcards(char *pattern, DirectoryCache *cache, WildcardMatch onMatch, void *arg) {
+    WildcardSearch s = {cache, onMatch, arg, NULL, 0, 0};
+
+    matchComponents(&s, 0, pattern);
+    free(s.path);
+    return s.matches;
+}
+
+/**
+ * Releases the listings in cache \param cache.
+ * @param cache the cache.
+ */
+void freeDirectoryCache(DirectoryCache *cache) {
+    for (int i = 0; i < cache->numListings; i++) {
+        free(cache->listings[i].path);
+        free(cache->listings[i].names);
+        free(cache->listings[i].offsets);
+    }
+    free(cache->listings);
+    cache->listings = NULL;
+    cache->numListings = cache->listingsSize = 0;
+}
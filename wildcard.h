@@ -0,0 +1,39 @@
+#ifndef SHELL_WILDCARD_H
+#define SHELL_WILDCARD_H
+
+#include <stdbool.h>
+#include <stddef.h>
+
+#define DIRENT_BUFFER_SIZE 65536
+#define INITIAL_LISTING_SIZE 4096
+
+// the sorted entries of one directory. The names are stored one after the other in a
+// single buffer, each preceded by its d_type byte and terminated by a NUL
+typedef struct DirectoryListing {
+    char *path;
+    char *names;
+    size_t *offsets;    // the offsets of the names in names, in sorted order
+    size_t count;
+} DirectoryListing;
+
+// the directories that were listed while expanding the words of a chain
+typedef struct DirectoryCache {
+    DirectoryListing *listings;
+    int numListings;
+    int listingsSize;
+} DirectoryCache;
+
+// called with every path that matches a pattern, in sorted order
+typedef void (*WildcardMatch)(char *path, void *arg);
+
+bool isWildcard(char c);
+
+bool isPattern(char *s, size_t n);
+
+int matchWildcards(char *pattern, DirectoryCache *cache, WildcardMatch onMatch, void *arg);
+
+void unescapeWord(char *s);
+
+void freeDirectoryCache(DirectoryCache *cache);
+
+#endif
@@ -0,0 +1,359 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <assert.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+#include "zygote.h"
+#include "pathcache.h"
+
+#define ZYGOTE_FDS 4    // stdin, stdout, stderr and the working directory
+
+// the socket to the zygote, or -1 when there is none
+int zygoteFd = -1;
+
+// the process that started the zygote; forked copies of the shell do not use it
+pid_t zygoteOwner = -1;
+
+// the strings of a spawn request
+char *zygoteBuffer = NULL;
+size_t zygoteBufferSize = 0;
+
+/**
+ * Sends \param len bytes from \param buf over socket \param fd, with \param numFds file
+ * descriptors \param fds attached to the first byte.
+ * @param fd the socket.
+ * @param buf the bytes.
+ * @param len the number of bytes.
+ * @param fds the file descriptors.
+ * @param numFds the number of file descriptors, at most ZYGOTE_FDS.
+ * @return a bool denoting whether everything was sent.
+ */
+bool sendWithFds(int fd, void *buf, size_t len, int *fds, int numFds) {
+    char control[CMSG_SPACE(ZYGOTE_FDS * sizeof(int))];
+    struct iovec iov = {buf, len};
+    struct msghdr msg = {0};
+
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    if (numFds > 0) {
+        msg.msg_control = control;
+        msg.msg_controllen = CMSG_SPACE(numFds * sizeof(int));
+        struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg);
+        cmsg->cmsg_level = SOL_SOCKET;
+        cmsg->cmsg_type = SCM_RIGHTS;
+        cmsg->cmsg_len = CMSG_LEN(numFds * sizeof(int));
+        memcpy(CMSG_DATA(cmsg), fds, numFds * sizeof(int));
+    }
+
+    while (len > 0) {
+        ssize_t n = sendmsg(fd, &msg, MSG_NOSIGNAL);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        iov.iov_base = (char *)iov.iov_base + n;
+        iov.iov_len = len -= n;
+        msg.msg_control = NULL;     // the descriptors went with the first part
+        msg.msg_controllen = 0;
+    }
+    return true;
+}
+
+/**
+ * Receives exactly \param len bytes into \param buf from socket \param fd, together with
+ * the file descriptors that are attached to them. The descriptors are close-on-exec.
+ * @param fd the socket.
+ * @param buf the buffer.
+ * @param len the number of bytes.
+ * @param fds where the file descriptors are stored, or NULL when none are expected.
+ * @param numFds set to the number of file descriptors, when \param fds is not NULL.
+ * @return a bool denoting whether all bytes were received.
+ */
+bool receiveWithFds(int fd, void *buf, size_t len, int *fds, int *numFds) {
+    char control[CMSG_SPACE(ZYGOTE_FDS * sizeof(int))];
+    struct iovec iov = {buf, len};
+    struct msghdr msg = {0};
+
+    if (numFds != NULL) *numFds = 0;
+    while (iov.iov_len > 0) {
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        ssize_t n = recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return false;
+
+        for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(&msg); cmsg != NULL; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                int count = (cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+                if (fds != NULL && *numFds + count <= ZYGOTE_FDS) {
+                    memcpy(fds + *numFds, CMSG_DATA(cmsg), count * sizeof(int));
+                    *numFds += count;
+                } else {    // unexpected descriptors are not kept open
+                    int *unexpected = (int *)CMSG_DATA(cmsg);
+                    for (int i = 0; i < count; i++) close(unexpected[i]);
+                }
+            }
+        }
+        iov.iov_base = (char *)iov.iov_base + n;
+        iov.iov_len -= n;
+    }
+    return true;
+}
+
+/**
+ * Starts the program of a spawn request in a child of the zygote. The child gets the
+ * received descriptors as stdin, stdout and stderr, and the received directory as
+ * working directory. A close-on-exec pipe tells whether execve succeeded.
+ * @param strings the path, the argument list and the environment, separated by NULs.
+ * @param req the request.
+ * @param fds the received file descriptors.
+ * @param numFds the number of file descriptors.
+ * @param reply where the pid of the child or the error is stored.
+ */
+void zygoteStart(char *strings, ZygoteRequest *req, int *fds, int numFds, ZygoteReply *reply) {
+    char **argv = malloc((req->argc + req->envc + 2) * sizeof(*argv));
+    assert(argv != NULL);
+    char **envp = argv + req->argc + 1;
+    char *path = strings;
+    char *s = path + strlen(path) + 1;
+
+    for (int i = 0; i < req->argc + req->envc; i++) {
+        argv[i < req->argc ? i : i + 1] = s;
+        s += strlen(s) + 1;
+    }
+    argv[req->argc] = NULL;
+    envp[req->envc] = NULL;
+
+    int errPipe[2];
+    if (pipe2(errPipe, O_CLOEXEC) == -1) {
+        reply->pid = -1;
+        reply->error = errno;
+        free(argv);
+        return;
+    }
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        for (int i = 0; i < 3 && i < numFds; i++) {
+            if (fds[i] != i) dup2(fds[i], i);
+        }
+        if (numFds > 3 && fchdir(fds[3]) == -1) {
+            // the directory is gone; the program runs where the zygote is
+        }
+        executePath(path, argv, envp);
+        int error = errno;
+        if (write(errPipe[1], &error, sizeof(error)) != sizeof(error)) {
+            // the zygote then assumes that the program was executed
+        }
+        _exit(127);
+    }
+    close(errPipe[1]);
+
+    int error;
+    ssize_t n;
+    while ((n = read(errPipe[0], &error, sizeof(error))) == -1 && errno == EINTR) {
+    }
+    close(errPipe[0]);
+
+    reply->pid = pid;
+    reply->error = pid == -1 ? errno : 0;
+    if (pid != -1 && n == sizeof(error)) {  // execve failed
+        waitpid(pid, NULL, 0);
+        reply->pid = -1;
+        reply->error = error;
+    }
+    free(argv);
+}
+
+/**
+ * The main loop of the zygote: it serves the requests of the shell until the shell
+ * closes the socket.
+ * @param fd the socket.
+ */
+void runZygote(int fd) {
+    char *strings = NULL;
+    size_t stringsSize = 0;
+
+    while (true) {
+        ZygoteRequest req;
+        ZygoteReply reply;
+        int fds[ZYGOTE_FDS];
+        int numFds;
+
+        if (!receiveWithFds(fd, &req, sizeof(req), fds, &numFds)) {
+            _exit(0);
+        }
+        memset(&reply, 0, sizeof(reply));
+
+        if (req.type == ZYGOTE_WAIT) {
+            reply.pid = req.pid;
+            while (wait4(req.pid, &reply.status, 0, &reply.usage) == -1) {
+                if (errno != EINTR) {
+                    reply.error = errno;
+                    break;
+                }
+            }
+        } else {
+            if (req.length > stringsSize) {
+                stringsSize = req.length;
+                strings = realloc(strings, stringsSize);
+                assert(strings != NULL);
+            }
+            if (!receiveWithFds(fd, strings, req.length, NULL, NULL)) {
+                _exit(0);
+            }
+            zygoteStart(strings, &req, fds, numFds, &reply);
+        }
+
+        for (int i = 0; i < numFds; i++) {
+            close(fds[i]);
+        }
+        if (!sendWithFds(fd, &reply, sizeof(reply), NULL, 0)) {
+            _exit(0);
+        }
+    }
+}
+
+/**
+ * Starts the zygote: a helper process that creates the child processes of the shell.
+ * It is forked while the shell is still small, so forking it later stays cheap however
+ * much memory the shell uses by then.
+ * @return a bool denoting whether the zygote is running.
+ */
+bool startZygote() {
+    int sv[2];
+
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) == -1) {
+        return false;
+    }
+    pid_t pid = fork();
+    if (pid == -1) {
+        close(sv[0]);
+        close(sv[1]);
+        return false;
+    }
+
+    if (pid == 0) {
+        // the zygote must not keep the terminal or pipes of the shell open
+        int devNull = open("/dev/null", O_RDWR);
+        for (int i = 0; i < 3; i++) {
+            dup2(devNull, i);
+        }
+        if (devNull > 2) close(devNull);
+        close(sv[0]);
+        signal(SIGCHLD, SIG_DFL);
+        runZygote(sv[1]);
+    }
+
+    close(sv[1]);
+    zygoteFd = sv[0];
+    zygoteOwner = getpid();
+    return true;
+}
+
+/**
+ * Checks whether the zygote can be used. Only the shell that started it may use it: a
+ * forked copy of the shell has to wait for its own children.
+ * @return a bool denoting whether the zygote can be used.
+ */
+bool zygoteAvailable() {
+    return zygoteFd != -1 && getpid() == zygoteOwner;
+}
+
+/**
+ * Stops using the zygote after communication with it failed.
+ */
+void closeZygote() {
+    printf("Error: the zygote terminated\n");
+    close(zygoteFd);
+    zygoteFd = -1;
+}
+
+/**
+ * Copies string \param s, including its NUL, to the request buffer at \param pos.
+ * @param s the string.
+ * @param pos the position in the buffer.
+ * @return the position after the string.
+ */
+size_t putZygoteString(char *s, size_t pos) {
+    size_t len = strlen(s) + 1;
+
+    if (pos + len > zygoteBufferSize) {
+        zygoteBufferSize = zygoteBufferSize == 0 ? INITIAL_ZYGOTE_BUFFER_SIZE : zygoteBufferSize;
+        while (pos + len > zygoteBufferSize) {
+            zygoteBufferSize = 2 * zygoteBufferSize;
+        }
+        zygoteBuffer = realloc(zygoteBuffer, zygoteBufferSize);
+        assert(zygoteBuffer != NULL);
+    }
+    memcpy(zygoteBuffer + pos, s, len);
+    return pos + len;
+}
+
+/**
+ * Lets the zygote start program \param path with argument list \param argv, environment
+ * \param envp and the current working directory of the shell.
+ * @param path the path of the program.
+ * @param argv the argument list.
+ * @param stdFds the file descriptors that become stdin, stdout and stderr of the child.
+ * @param envp the environment of the child.
+ * @return the pid of the child, or -1 with errno set when it could not be started. When
+ * the zygote itself failed, zygoteAvailable no longer holds.
+ */
+pid_t zygoteSpawn(char *path, char **argv, int stdFds[3], char **envp) {
+    ZygoteRequest req = {ZYGOTE_SPAWN, 0, 0, 0, 0};
+    ZygoteReply reply;
+    size_t pos = putZygoteString(path, 0);
+
+    for (; argv[req.argc] != NULL; req.argc++) {
+        pos = putZygoteString(argv[req.argc], pos);
+    }
+    for (; envp[req.envc] != NULL; req.envc++) {
+        pos = putZygoteString(envp[req.envc], pos);
+    }
+    req.length = pos;
+
+    int fds[ZYGOTE_FDS] = {stdFds[0], stdFds[1], stdFds[2], open(".", O_PATH | O_DIRECTORY | O_CLOEXEC)};
+    bool sent = sendWithFds(zygoteFd, &req, sizeof(req), fds, fds[3] == -1 ? 3 : 4) &&
+                sendWithFds(zygoteFd, zygoteBuffer, req.length, NULL, 0);
+    if (fds[3] != -1) close(fds[3]);
+
+    if (!sent || !receiveWithFds(zygoteFd, &reply, sizeof(reply), NULL, NULL)) {
+        closeZygote();
+        errno = ECHILD;
+        return -1;
+    }
+    errno = reply.error;
+    return reply.pid;
+}
+
+/**
+ * Lets the zygote wait for its child \param pid.
+ * @param pid the child.
+ * @param status set to the wait status of the child.
+ * @param usage set to the resource usage of the child.
+ * @return a bool denoting whether the child was waited for.
+ */
+bool zygoteWait(pid_t pid, int *status, struct rusage *usage) {
+    ZygoteRequest req = {ZYGOTE_WAIT, pid, 0, 0, 0};
+    ZygoteReply reply;
+
+    if (!sendWithFds(zygoteFd, &req, sizeof(req), NULL, 0) ||
+        !receiveWithFds(zygoteFd, &reply, sizeof(reply), NULL, NULL)) {
+        closeZygote();
+        return false;
+    }
+    *status = reply.status;
+    *usage = reply.usage;
+    return reply.error == 0;
+}
@@ -0,0 +1,39 @@
+#ifndef SHELL_ZYGOTE_H
+#define SHELL_ZYGOTE_H
+
+#include <stdbool.h>
+#include <sys/types.h>
+#include <sys/resource.h>
+
+#define INITIAL_ZYGOTE_BUFFER_SIZE 4096
+
+typedef enum ZygoteRequestType {
+    ZYGOTE_SPAWN,   // start a program; followed by the path, argv and environment
+    ZYGOTE_WAIT     // wait for a child that the zygote started
+} ZygoteRequestType;
+
+// sent by the shell, with stdin, stdout, stderr and the working directory as SCM_RIGHTS
+typedef struct ZygoteRequest {
+    ZygoteRequestType type;
+    pid_t pid;          // the child to wait for
+    int argc;
+    int envc;
+    size_t length;      // the number of bytes of strings that follow the request
+} ZygoteRequest;
+
+typedef struct ZygoteReply {
+    pid_t pid;          // the child that was started, or -1
+    int error;          // errno when starting or waiting failed
+    int status;         // the wait status of the child
+    struct rusage usage;
+} ZygoteReply;
+
+bool startZygote();
+
+bool zygoteAvailable();
+
+pid_t zygoteSpawn(char *path, char **argv, int stdFds[3], char **envp);
+
+bool zygoteWait(pid_t pid, int *status, struct rusage *usage);
+
+#endif